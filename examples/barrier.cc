@@ -0,0 +1,99 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/barrier.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/latch.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Workers run phases in lockstep: every phase each worker publishes a
+ * value, the completion function checks all of them are there before
+ * anybody moves on. Latches are used as a start gate and to wait for all
+ * the workers to finish.
+ */
+
+enum { num_workers = 4 };
+enum { num_phases = 1000 };
+
+static int values[num_workers];
+static int current_phase = 0;
+static future::internal::atomic<int> num_errors(0);
+static future::internal::atomic<int> num_completers(0);
+
+static void complete_phase(void) {
+  for (int i = 0; i < num_workers; ++i) {
+    if (values[i] != current_phase) {
+      num_errors.fetch_add(1);
+    }
+  }
+  ++current_phase;
+}
+
+static future::barrier phase_barrier(num_workers,
+                                     function_bind(complete_phase));
+static future::latch start_gate(1);
+static future::latch all_done(num_workers);
+
+static void worker(int index) {
+  start_gate.wait();
+  for (int phase = 0; phase < num_phases; ++phase) {
+    values[index] = phase;
+    if (phase_barrier.arrive_and_wait()) {
+      num_completers.fetch_add(1);
+    }
+  }
+  all_done.count_down();
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> threads;
+  for (int i = 0; i < num_workers; ++i) {
+    threads.push_back(new future::thread(function_bind(worker, i)));
+  }
+  printf("Workers are waiting at the gate: %s\n",
+         start_gate.try_wait() ? "no" : "yes");
+  start_gate.count_down();
+  while (!all_done.wait_for(1000)) {
+    printf("Still waiting for workers\n");
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  printf("Phases completed: %d, completing threads: %d, errors: %d\n",
+         current_phase, num_completers.load(), num_errors.load());
+  if (current_phase != num_phases ||
+      num_completers.load() != num_phases ||
+      num_errors.load() != 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/blocking_queue.h"
+#include "future/function.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Producers push batches into a small bounded queue, consumers drain it in
+ * batches. Every value is to be consumed exactly once.
+ */
+
+enum { num_producers = 2 };
+enum { num_consumers = 2 };
+enum { num_values_per_producer = 100000 };
+enum { batch_size = 100 };
+
+static future::blocking_queue<int> queue(64);
+static future::internal::atomic<long long> consumed_sum(0);
+static future::internal::atomic<int> num_consumed(0);
+static future::internal::atomic<int> producers_finished(0);
+
+static void producer(int index) {
+  std::vector<int> batch;
+  for (int i = 0; i < num_values_per_producer; ++i) {
+    batch.push_back(index * num_values_per_producer + i);
+    if (batch.size() == batch_size) {
+      queue.push_many(batch.begin(), batch.end());
+      batch.clear();
+    }
+  }
+  queue.push_many(batch.begin(), batch.end());
+}
+
+static void consumer(void) {
+  std::vector<int> values;
+  for (;;) {
+    /* Flag is checked before popping: if it was set, everything was pushed
+     * already, so an empty queue means there is nothing left to consume.
+     */
+    bool finished = producers_finished.load() != 0;
+    values.clear();
+    if (queue.pop_up_to(32, 10, &values) == 0 && finished) {
+      return;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+      consumed_sum.fetch_add(values[i]);
+      num_consumed.fetch_add(1);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> threads;
+  for (int i = 0; i < num_consumers; ++i) {
+    threads.push_back(new future::thread(function_bind(consumer)));
+  }
+  for (int i = 0; i < num_producers; ++i) {
+    threads.push_back(new future::thread(function_bind(producer, i)));
+  }
+  for (int i = num_consumers; i < (int)threads.size(); ++i) {
+    threads[i]->join();
+  }
+  producers_finished.store(1);
+  for (int i = 0; i < num_consumers; ++i) {
+    threads[i]->join();
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    delete threads[i];
+  }
+
+  long long num_values = (long long)num_producers * num_values_per_producer;
+  long long expected_sum = num_values * (num_values - 1) / 2;
+  printf("Consumed %d values, sum %lld (expected %lld)\n",
+         num_consumed.load(), consumed_sum.load(), expected_sum);
+
+  int value;
+  bool pushed = queue.try_push(42);
+  bool popped = queue.try_pop(&value);
+  std::vector<int> rest;
+  printf("try_push: %d, try_pop: %d, left: %d\n",
+         (int)pushed, (int)popped, (int)queue.pop_up_to(10, 0, &rest));
+
+  if (num_consumed.load() != num_values ||
+      consumed_sum.load() != expected_sum) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
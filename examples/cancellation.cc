@@ -0,0 +1,115 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/cancellation.h"
+#include "future/function.h"
+#include "future/thread.h"
+#include "future/thread_pool.h"
+
+using future::bind::function_bind;
+
+static future::internal::atomic<int> callback_started(0);
+static future::internal::atomic<int> callback_finished(0);
+static future::internal::atomic<int> num_tasks_run(0);
+
+static void slow_callback(void) {
+  callback_started.store(1);
+  usleep(1000);
+  callback_finished.store(1);
+}
+
+static void cancel(future::cancellation_source *source) {
+  source->cancel();
+}
+
+static void print_cancelled(const char *message) {
+  printf("%s\n", message);
+}
+
+static void task(void) {
+  num_tasks_run.fetch_add(1);
+}
+
+/* Destroys a registration while its callback is being run by cancel() in
+ * another thread, destructor is to wait for the callback to finish.
+ */
+static bool destroy_during_callback(bool wait_for_start) {
+  future::cancellation_source source;
+  callback_started.store(0);
+  callback_finished.store(0);
+  future::cancellation_registration *registration =
+      new future::cancellation_registration(source.token(),
+                                            function_bind(slow_callback));
+  future::thread canceller(function_bind(cancel, &source));
+  while (wait_for_start && callback_started.load() == 0) {
+    future::internal::cpu_relax();
+  }
+  delete registration;
+  bool ok = callback_started.load() == 0 || callback_finished.load() != 0;
+  canceller.join();
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  future::cancellation_source source;
+  future::cancellation_token token = source.token();
+  {
+    future::cancellation_registration registration(
+        token, function_bind(print_cancelled, "Cancellation requested"));
+    printf("Cancelled before: %d\n", (int)token.is_cancelled());
+    source.cancel();
+    printf("Cancelled after: %d\n", (int)token.is_cancelled());
+  }
+  /* Registration on a cancelled token runs the callback right away. */
+  future::cancellation_registration late_registration(
+      token, function_bind(print_cancelled, "Token was cancelled already"));
+
+  for (int i = 0; i < 200; ++i) {
+    if (!destroy_during_callback(i % 2 == 0)) {
+      printf("Registration destroyed while its callback was running\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  {
+    future::thread_pool pool(2);
+    future::cancellation_source pool_source;
+    pool.submit(function_bind(task), pool_source.token());
+    pool_source.cancel();
+    for (int i = 0; i < 10; ++i) {
+      pool.submit(function_bind(task), pool_source.token());
+    }
+  }
+  printf("Tasks run: %d\n", num_tasks_run.load());
+  if (num_tasks_run.load() > 1) {
+    printf("Cancelled tasks were run\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
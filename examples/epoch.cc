@@ -0,0 +1,133 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/epoch.h"
+#include "future/function.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Lock-free stack whose popped nodes are reclaimed with epochs. Workers
+ * stay alive after their work is done, while the main thread collects
+ * their garbage like a maintenance thread would.
+ */
+
+static future::internal::atomic<int> num_live_nodes(0);
+
+struct node {
+  explicit node(int value) : value(value), next(NULL) {
+    num_live_nodes.fetch_add(1);
+  }
+
+  ~node() {
+    num_live_nodes.fetch_sub(1);
+  }
+
+  int value;
+  node *next;
+};
+
+static future::epoch domain;
+static future::internal::atomic<node*> head(NULL);
+static future::internal::atomic<int> num_finished(0);
+static future::internal::atomic<int> stop(0);
+
+static void push(int value) {
+  node *new_node = new node(value);
+  node *current = head.load();
+  do {
+    new_node->next = current;
+  } while (!head.compare_exchange_weak(current, new_node));
+}
+
+static bool pop(int *value) {
+  future::epoch::guard guard(domain);
+  node *current = head.load();
+  for (;;) {
+    if (current == NULL) {
+      return false;
+    }
+    /* Node can't be freed while we're inside of the guard. */
+    if (head.compare_exchange_weak(current, current->next)) {
+      break;
+    }
+  }
+  *value = current->value;
+  domain.retire(current);
+  return true;
+}
+
+static void worker(int num_operations) {
+  for (int i = 0; i < num_operations; ++i) {
+    int value;
+    push(i);
+    pop(&value);
+  }
+  num_finished.fetch_add(1);
+  while (!stop.load()) {
+    future::internal::cpu_relax();
+  }
+}
+
+int main(int argc, char **argv) {
+  const int num_workers = 3;
+  std::vector<future::thread*> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.push_back(new future::thread(function_bind(worker, 100000)));
+  }
+  while (num_finished.load() != num_workers) {
+    future::internal::cpu_relax();
+  }
+
+  /* Few collects to move the epoch far enough, workers are still alive. */
+  for (int i = 0; i < 4; ++i) {
+    domain.collect();
+  }
+  int num_unreclaimed = num_live_nodes.load();
+  printf("Nodes left after collecting while workers are alive: %d\n",
+         num_unreclaimed);
+
+  stop.store(1);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i]->join();
+    delete workers[i];
+  }
+  int value;
+  while (pop(&value)) {
+  }
+  for (int i = 0; i < 4; ++i) {
+    domain.collect();
+  }
+  printf("Nodes left after workers exited: %d\n", num_live_nodes.load());
+
+  /* Every worker buffers less than a batch of its own retirements. */
+  if (num_unreclaimed > num_workers * 64 || num_live_nodes.load() != 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
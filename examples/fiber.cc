@@ -0,0 +1,89 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/fiber.h"
+#include "future/function.h"
+
+using future::bind::function_bind;
+
+/* Thousands of consumers waiting for requests, all of them share the
+ * threads of the default pool.
+ */
+
+static const int num_consumers = 5000;
+static const int num_requests = 100000;
+
+static future::fiber_mutex queue_mutex;
+static future::fiber_condition_variable queue_condition;
+static std::deque<int> queue;
+static bool done = false;
+static long long result = 0;
+
+static void consumer() {
+  future::fiber_mutex::scoped_lock lock(queue_mutex);
+  for (;;) {
+    while (queue.empty() && !done) {
+      queue_condition.wait(lock);
+    }
+    if (queue.empty()) {
+      break;
+    }
+    result += queue.front();
+    queue.pop_front();
+  }
+}
+
+static void producer() {
+  for (int i = 0; i < num_requests; ++i) {
+    future::fiber_mutex::scoped_lock lock(queue_mutex);
+    queue.push_back(i);
+    queue_condition.notify_one();
+    if (i % 100 == 0) {
+      lock.unlock();
+      future::fiber::yield();
+    }
+  }
+  future::fiber_mutex::scoped_lock lock(queue_mutex);
+  done = true;
+  queue_condition.notify_all();
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::fiber*> consumers;
+  for (int i = 0; i < num_consumers; ++i) {
+    consumers.push_back(new future::fiber(function_bind(consumer)));
+  }
+  future::fiber producer_fiber(function_bind(producer));
+  producer_fiber.join();
+  for (int i = 0; i < num_consumers; ++i) {
+    consumers[i]->join();
+    delete consumers[i];
+  }
+  printf("Result is: %lld\n", result);
+  return EXIT_SUCCESS;
+}
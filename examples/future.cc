@@ -0,0 +1,117 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/future.h"
+#include "future/placeholders.h"
+#include "future/thread_pool.h"
+
+using future::bind::function_bind;
+using future::placeholders::_1;
+
+static void compute(future::promise<int> *promise, int value) {
+  promise->set_value(value * 2);
+}
+
+static int square(int value) {
+  return value * value;
+}
+
+static double half(int value) {
+  return value / 2.0;
+}
+
+static void print(double value) {
+  printf("Value in the continuation: %f\n", value);
+}
+
+static int answer(void) {
+  return 42;
+}
+
+int main(int argc, char **argv) {
+  future::thread_pool pool(2);
+
+  future::promise<int> promise;
+  future::future<int> value = promise.get_future();
+  /* Chain is constructed before the value is known, every stage runs as
+   * soon as the previous one is ready.
+   */
+  future::future<void> done = value.then(function_bind(square, _1), &pool)
+                                   .then(function_bind(half, _1))
+                                   .then(function_bind(print, _1), &pool);
+  pool.submit(function_bind(compute, &promise, 21));
+
+  printf("Value is: %d\n", value.get());
+  if (!done.wait_for(1000)) {
+    printf("Continuations did not finish in time\n");
+    return EXIT_FAILURE;
+  }
+
+  future::future<int> ready = future::make_ready_future()
+                                  .then(function_bind(answer));
+  printf("Ready value is: %d\n", ready.get());
+
+  /* Fan-out/fan-in. */
+  std::vector<future::promise<int>*> promises;
+  std::vector<future::future<int> > futures;
+  for (int i = 0; i < 10; ++i) {
+    promises.push_back(new future::promise<int>());
+    futures.push_back(promises.back()->get_future());
+  }
+  future::future<std::vector<int> > all =
+      future::when_all(futures.begin(), futures.end());
+  future::future<size_t> any =
+      future::when_any(futures.begin(), futures.end());
+  for (int i = 9; i >= 0; --i) {
+    pool.submit(function_bind(compute, promises[i], i));
+  }
+  const std::vector<int>& values = all.get();
+  for (size_t i = 0; i < values.size(); ++i) {
+    printf("when_all value %d is: %d\n", (int)i, values[i]);
+  }
+  printf("First ready future is: %d\n", (int)any.get());
+  for (int i = 0; i < 10; ++i) {
+    delete promises[i];
+  }
+
+  /* Promise destroyed without a value breaks its future and continuations
+   * instead of leaving waiters blocked forever.
+   */
+  future::future<int> abandoned;
+  future::future<int> abandoned_square;
+  {
+    future::promise<int> abandoned_promise;
+    abandoned = abandoned_promise.get_future();
+    abandoned_square = abandoned.then(function_bind(square, _1), &pool);
+  }
+  abandoned_square.wait();
+  printf("Abandoned future is broken: %s\n",
+         abandoned.is_broken() && abandoned_square.is_broken() ? "yes" : "no");
+
+  return EXIT_SUCCESS;
+}
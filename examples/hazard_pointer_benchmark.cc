@@ -0,0 +1,178 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "future/atomic.h"
+#include "future/clock.h"
+#include "future/hazard_pointer.h"
+#include "future/mutex.h"
+
+/* Read-heavy access to a shared object which is replaced by a single
+ * writer from time to time, protected by hazard pointers and by a mutex.
+ *
+ *   hazard_pointer_benchmark [num_readers] [duration_ms] [write_interval_us]
+ */
+
+struct config {
+  explicit config(unsigned int version) : first(version), second(~version) {}
+
+  /* Readers check first and second are consistent, so use-after-free is
+   * likely to be noticed.
+   */
+  unsigned int first;
+  unsigned int second;
+};
+
+static size_t num_readers = 4;
+static unsigned int duration_ms = 1000;
+static unsigned int write_interval_us = 100;
+
+static future::internal::atomic<int> stop(0);
+static future::internal::atomic<int> num_errors(0);
+
+static future::internal::atomic<config*> hazard_config(NULL);
+
+static future::mutex config_mutex("benchmark_config");
+static config *mutex_config = NULL;
+
+static bool is_consistent(const config *current) {
+  return current->second == ~current->first;
+}
+
+static void *hazard_reader(void *arg) {
+  future::hazard_pointer hazard;
+  size_t num_reads = 0;
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    config *current = hazard.protect(hazard_config);
+    if (!is_consistent(current)) {
+      num_errors.fetch_add(1);
+    }
+    hazard.reset();
+    ++num_reads;
+  }
+  *static_cast<size_t*>(arg) = num_reads;
+  return NULL;
+}
+
+static void *hazard_writer(void * /*arg*/) {
+  future::hazard_domain& domain = future::hazard_domain::default_domain();
+  unsigned int version = 0;
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    config *old_config = hazard_config.exchange(new config(++version));
+    domain.retire(old_config);
+    usleep(write_interval_us);
+  }
+  domain.collect();
+  return NULL;
+}
+
+static void *mutex_reader(void *arg) {
+  size_t num_reads = 0;
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    future::mutex::scoped_lock lock(config_mutex);
+    if (!is_consistent(mutex_config)) {
+      num_errors.fetch_add(1);
+    }
+    ++num_reads;
+  }
+  *static_cast<size_t*>(arg) = num_reads;
+  return NULL;
+}
+
+static void *mutex_writer(void * /*arg*/) {
+  unsigned int version = 0;
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    config *new_config = new config(++version);
+    config *old_config;
+    {
+      future::mutex::scoped_lock lock(config_mutex);
+      old_config = mutex_config;
+      mutex_config = new_config;
+    }
+    delete old_config;
+    usleep(write_interval_us);
+  }
+  return NULL;
+}
+
+static void run(const char *name,
+                void *(*reader)(void *),
+                void *(*writer)(void *)) {
+  pthread_t *reader_threads = new pthread_t[num_readers];
+  size_t *num_reads = new size_t[num_readers];
+  pthread_t writer_thread;
+
+  stop.store(0);
+  uint64_t start_time = future::internal::monotonic_time_ns();
+  pthread_create(&writer_thread, NULL, writer, NULL);
+  for (size_t i = 0; i < num_readers; ++i) {
+    pthread_create(&reader_threads[i], NULL, reader, &num_reads[i]);
+  }
+  usleep(duration_ms * 1000);
+  stop.store(1);
+  size_t total_reads = 0;
+  for (size_t i = 0; i < num_readers; ++i) {
+    pthread_join(reader_threads[i], NULL);
+    total_reads += num_reads[i];
+  }
+  pthread_join(writer_thread, NULL);
+  double seconds = (future::internal::monotonic_time_ns() - start_time) / 1e9;
+
+  printf("%-16s %10.1f M reads/sec\n", name, total_reads / seconds / 1e6);
+  delete [] reader_threads;
+  delete [] num_reads;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    num_readers = strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    duration_ms = strtoul(argv[2], NULL, 10);
+  }
+  if (argc > 3) {
+    write_interval_us = strtoul(argv[3], NULL, 10);
+  }
+  printf("Readers: %lu, duration: %u ms, write interval: %u us\n",
+         (unsigned long)num_readers, duration_ms, write_interval_us);
+
+  hazard_config.store(new config(0));
+  mutex_config = new config(0);
+
+  run("hazard_pointer", hazard_reader, hazard_writer);
+  run("mutex", mutex_reader, mutex_writer);
+
+  future::hazard_domain::default_domain().retire(hazard_config.load());
+  future::hazard_domain::default_domain().collect();
+  delete mutex_config;
+
+  if (num_errors.load() != 0) {
+    printf("Inconsistent reads: %d\n", num_errors.load());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#define FUTURE_MUTEX_PROFILING
+
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+#include <pthread.h>
+
+#include "future/lock_stats.h"
+#include "future/mutex.h"
+
+static future::mutex counter_mutex("counter_mutex");
+static future::mutex quiet_mutex("quiet_mutex");
+static int counter = 0;
+
+static void *worker(void * /*arg*/) {
+  for (int i = 0; i < 100000; ++i) {
+    future::mutex::scoped_lock lock(counter_mutex);
+    ++counter;
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  pthread_t threads[4];
+  for (int i = 0; i < 4; ++i) {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  for (int i = 0; i < 4; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  {
+    future::mutex::scoped_lock lock(quiet_mutex);
+    printf("Counter value is: %d\n", counter);
+  }
+  printf("%s", future::lock_stats::dump_text().c_str());
+  printf("%s", future::lock_stats::dump_json().c_str());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/mpmc_queue.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Producers and consumers pass values through a small queue, so both sides
+ * keep parking on it. Every value is to be consumed exactly once, zero is
+ * used to tell a consumer to stop.
+ */
+
+enum { num_producers = 3 };
+enum { num_consumers = 3 };
+enum { num_values_per_producer = 100000 };
+
+static future::mpmc_queue<int> queue(16);
+static future::internal::atomic<long long> consumed_sum(0);
+static future::internal::atomic<int> num_consumed(0);
+
+static void producer(int index) {
+  for (int i = 1; i <= num_values_per_producer; ++i) {
+    int value = index * num_values_per_producer + i;
+    /* Mix blocking and non-blocking pushes. */
+    if (i % 2 == 0 || !queue.try_push(value)) {
+      queue.push(value);
+    }
+  }
+}
+
+static void consumer(void) {
+  long long sum = 0;
+  int count = 0;
+  for (;;) {
+    int value;
+    if (!queue.try_pop(&value)) {
+      queue.pop(&value);
+    }
+    if (value == 0) {
+      break;
+    }
+    sum += value;
+    ++count;
+  }
+  consumed_sum.fetch_add(sum);
+  num_consumed.fetch_add(count);
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> consumers, producers;
+  for (int i = 0; i < num_consumers; ++i) {
+    consumers.push_back(new future::thread(function_bind(consumer)));
+  }
+  for (int i = 0; i < num_producers; ++i) {
+    producers.push_back(new future::thread(function_bind(producer, i)));
+  }
+  for (size_t i = 0; i < producers.size(); ++i) {
+    producers[i]->join();
+    delete producers[i];
+  }
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    queue.push(0);
+  }
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    consumers[i]->join();
+    delete consumers[i];
+  }
+
+  long long num_values = (long long)num_producers * num_values_per_producer;
+  long long expected_sum = num_values * (num_values + 1) / 2;
+  printf("Queue capacity: %d\n", (int)queue.capacity());
+  printf("Consumed %d values, sum %lld (expected %lld)\n",
+         num_consumed.load(), consumed_sum.load(), expected_sum);
+  if (num_consumed.load() != num_values ||
+      consumed_sum.load() != expected_sum) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
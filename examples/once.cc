@@ -0,0 +1,90 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/once.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Lazily initialized table shared by threads which all race to be the
+ * first user. Initialization is slow enough for other threads to block
+ * on it, and nobody is to see a partially initialized table.
+ */
+
+enum { table_size = 1024 };
+
+static future::once_flag table_once;
+static int *table = NULL;
+static future::internal::atomic<int> num_initializations(0);
+static future::internal::atomic<int> num_errors(0);
+
+static void initialize_table(void) {
+  num_initializations.fetch_add(1);
+  int *new_table = new int[table_size];
+  for (int i = 0; i < table_size; ++i) {
+    new_table[i] = i * i;
+  }
+  usleep(10 * 1000);
+  table = new_table;
+}
+
+static future::once_flag greeting_once;
+
+static void greet(const char *greeting) {
+  printf("%s\n", greeting);
+}
+
+static void user(int index) {
+  future::call_once(table_once, initialize_table);
+  if (table == NULL || table[index] != index * index) {
+    num_errors.fetch_add(1);
+  }
+  future::call_once(greeting_once,
+                    function_bind(greet, "Greeting is printed once"));
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.push_back(new future::thread(function_bind(user, i)));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  printf("Table initialized %d time(s), done: %s\n",
+         num_initializations.load(), table_once.done() ? "yes" : "no");
+  delete [] table;
+  if (num_initializations.load() != 1 || num_errors.load() != 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+#include "future/parallel_foreach.h"
+
+using std::vector;
+
+struct normalize {
+  explicit normalize(double scale) : scale(scale) {}
+
+  void operator()(double& value) const {
+    value = std::sqrt(value) * scale;
+  }
+
+  double scale;
+};
+
+int main(int argc, char **argv) {
+  vector<double> values(1000000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = (double)i;
+  }
+
+  future::parallel_for_each(values, normalize(0.5));
+  printf("Value after normalization: %f\n", values[10000]);
+
+#ifdef FUTURE_PARALLEL_FOREACH
+  FUTURE_PARALLEL_FOREACH(double& value, values) {
+    value *= 2.0;
+  };
+  printf("Value after scaling: %f\n", values[10000]);
+#endif
+
+  return EXIT_SUCCESS;
+}
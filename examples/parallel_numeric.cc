@@ -0,0 +1,81 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/parallel_numeric.h"
+#include "future/placeholders.h"
+#include "future/thread_pool.h"
+
+using std::vector;
+
+static double identity(double value) {
+  return value;
+}
+
+static double add(double a, double b) {
+  return a + b;
+}
+
+struct square {
+  double operator()(double value) const {
+    return value * value;
+  }
+};
+
+int main(int argc, char **argv) {
+  using future::bind::function_bind;
+  using future::function::function;
+  using future::placeholders::_1;
+  using future::placeholders::_2;
+
+  vector<double> values(3000000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = 1.0 / (double)(i + 1);
+  }
+
+  /* Sums are bit-exact no matter how many threads are used. */
+  function<double(double, double)> combine = function_bind(add, _1, _2);
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    future::thread_pool pool(num_threads);
+    double sum = future::parallel_reduce(values.begin(), values.end(),
+                                         0.0, identity, add, &pool);
+    double sum_of_squares = future::parallel_reduce(values.begin(),
+                                                    values.end(),
+                                                    0.0,
+                                                    square(),
+                                                    combine,
+                                                    &pool);
+    printf("Threads: %d, sum: %.17g, sum of squares: %.17g\n",
+           num_threads, sum, sum_of_squares);
+  }
+
+  future::parallel_inclusive_scan(values.begin(), values.end(),
+                                  values.begin(), add);
+  printf("Last prefix sum: %.17g\n", values.back());
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/parallel_algorithm.h"
+#include "future/placeholders.h"
+
+using std::vector;
+
+static bool greater(int a, int b) {
+  return a > b;
+}
+
+/* Record without operator<, only sortable with a comparator. */
+struct record {
+  int key;
+  int payload;
+};
+
+static bool record_less(const record& a, const record& b) {
+  return a.key < b.key;
+}
+
+static bool is_sorted(const vector<int>& values) {
+  for (size_t i = 1; i < values.size(); ++i) {
+    if (values[i] < values[i - 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  using future::bind::function_bind;
+  using future::function::function;
+  using future::placeholders::_1;
+  using future::placeholders::_2;
+
+  vector<int> keys(1000000);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = rand();
+  }
+  future::parallel_sort(keys.begin(), keys.end());
+  printf("Keys are sorted: %s\n", is_sorted(keys) ? "yes" : "no");
+
+  vector<int> odd, even, merged(1000);
+  for (int i = 0; i < 500; ++i) {
+    odd.push_back(i * 2 + 1);
+    even.push_back(i * 2);
+  }
+  future::parallel_merge(odd.begin(), odd.end(),
+                         even.begin(), even.end(),
+                         merged.begin());
+  printf("Merged values are sorted: %s\n", is_sorted(merged) ? "yes" : "no");
+
+  function<bool(int, int)> compare = function_bind(greater, _1, _2);
+  future::parallel_sort(merged.begin(), merged.end(), compare);
+  printf("First value in descending order: %d\n", merged[0]);
+
+  vector<record> records(100000);
+  for (size_t i = 0; i < records.size(); ++i) {
+    records[i].key = rand();
+    records[i].payload = (int)i;
+  }
+  future::parallel_sort(records.begin(), records.end(), record_less);
+  bool records_sorted = true;
+  for (size_t i = 1; i < records.size(); ++i) {
+    if (record_less(records[i], records[i - 1])) {
+      records_sorted = false;
+    }
+  }
+  printf("Records are sorted: %s\n", records_sorted ? "yes" : "no");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/cancellation.h"
+#include "future/function.h"
+#include "future/latch.h"
+#include "future/priority_executor.h"
+
+using future::bind::function_bind;
+using future::internal::atomic;
+using future::priority_executor;
+
+/* Tasks are queued while the only worker is held by a gate task, so the
+ * order in which they are dequeued afterwards is fully up to the policy.
+ */
+
+enum { num_tasks_per_priority = 16 };
+
+struct execution_log {
+  execution_log() : num_entries(0) {}
+
+  void add(int priority) {
+    int index = num_entries.fetch_add(1);
+    if (index < (int)entries.size()) {
+      entries[index] = priority;
+    }
+  }
+
+  std::vector<int> entries;
+  atomic<int> num_entries;
+};
+
+static void hold_worker(future::latch *blocked, future::latch *gate) {
+  blocked->count_down();
+  gate->wait();
+}
+
+static void record(execution_log *log, int priority) {
+  log->add(priority);
+}
+
+static void record_slowly(execution_log *log, int priority) {
+  usleep(1000);
+  log->add(priority);
+}
+
+static void increment(atomic<int> *counter) {
+  counter->fetch_add(1);
+}
+
+/* Strict policy with aging disabled always serves higher priority first. */
+static bool test_strict_order() {
+  execution_log log;
+  log.entries.resize(3 * num_tasks_per_priority, -1);
+  {
+    priority_executor executor(3, 1, priority_executor::policy_strict, 0);
+    future::latch blocked(1), gate(1);
+    executor.submit(function_bind(hold_worker, &blocked, &gate), 0);
+    blocked.wait();
+    /* Submit the least important tasks first. */
+    for (int priority = 2; priority >= 0; --priority) {
+      for (int i = 0; i < num_tasks_per_priority; ++i) {
+        executor.submit(function_bind(record, &log, priority), priority);
+      }
+    }
+    gate.count_down();
+  }
+  bool ok = log.num_entries.load() == (int)log.entries.size();
+  for (size_t i = 0; i < log.entries.size(); ++i) {
+    if (log.entries[i] != (int)i / num_tasks_per_priority) {
+      ok = false;
+    }
+  }
+  printf("Strict order: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+/* Aging lets a lone low priority task through a flood of high priority
+ * ones which would otherwise starve it.
+ */
+static bool test_aging() {
+  enum { num_flood_tasks = 200 };
+  execution_log log;
+  log.entries.resize(num_flood_tasks + 1, -1);
+  {
+    priority_executor executor(2, 1, priority_executor::policy_strict, 20);
+    future::latch blocked(1), gate(1);
+    executor.submit(function_bind(hold_worker, &blocked, &gate), 0);
+    blocked.wait();
+    executor.submit(function_bind(record, &log, 1), 1);
+    for (int i = 0; i < num_flood_tasks; ++i) {
+      executor.submit(function_bind(record_slowly, &log, 0), 0);
+    }
+    gate.count_down();
+  }
+  int position = -1;
+  for (size_t i = 0; i < log.entries.size(); ++i) {
+    if (log.entries[i] == 1) {
+      position = (int)i;
+    }
+  }
+  bool ok = log.num_entries.load() == (int)log.entries.size() &&
+            position != -1 && position < num_flood_tasks;
+  printf("Low priority task ran at position %d of %d: %s\n",
+         position, num_flood_tasks + 1, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+/* Task submitted with a token is dropped if cancelled before it starts. */
+static bool test_cancellation() {
+  atomic<int> num_runs(0);
+  {
+    priority_executor executor(2, 1);
+    future::cancellation_source source;
+    future::latch blocked(1), gate(1);
+    executor.submit(function_bind(hold_worker, &blocked, &gate), 0);
+    blocked.wait();
+    executor.submit(function_bind(increment, &num_runs), source.token());
+    executor.submit(function_bind(increment, &num_runs),
+                    future::cancellation_token());
+    source.cancel();
+    gate.count_down();
+  }
+  bool ok = num_runs.load() == 1;
+  printf("Cancelled task dropped: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+/* Weighted policy with all the workers: nothing gets lost. */
+static bool test_weighted() {
+  enum { num_priorities = 3, num_tasks = 10000 };
+  atomic<int> counters[num_priorities];
+  int num_threads;
+  {
+    priority_executor executor(num_priorities);
+    num_threads = executor.num_threads();
+    executor.set_weight(0, 4);
+    executor.set_weight(1, 2);
+    for (int i = 0; i < num_tasks; ++i) {
+      int priority = i % num_priorities;
+      executor.submit(function_bind(increment, &counters[priority]),
+                      priority);
+    }
+  }
+  int total = 0;
+  for (int i = 0; i < num_priorities; ++i) {
+    total += counters[i].load();
+  }
+  bool ok = total == num_tasks;
+  printf("Weighted policy on %d thread(s) ran %d of %d tasks: %s\n",
+         num_threads, total, num_tasks, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  bool ok = true;
+  ok &= test_strict_order();
+  ok &= test_aging();
+  ok &= test_cancellation();
+  ok &= test_weighted();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/rcu.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Routing table read by every request and replaced from time to time.
+ * Destructor poisons the table, so a reader which sees a freed version is
+ * likely to notice.
+ */
+struct routing_table {
+  explicit routing_table(int version) : version(version), routes(16) {
+    for (size_t i = 0; i < routes.size(); ++i) {
+      routes[i] = version * 100 + (int)i;
+    }
+  }
+
+  ~routing_table() {
+    version = -1;
+    routes.assign(routes.size(), -1);
+  }
+
+  int version;
+  std::vector<int> routes;
+};
+
+static future::rcu_ptr<routing_table> table(new routing_table(0));
+static future::internal::atomic<int> stop(0);
+static future::internal::atomic<int> num_errors(0);
+static future::internal::atomic<long> num_reads(0);
+static future::internal::atomic<int> num_started(0);
+
+static void reader(void) {
+  long count = 0;
+  num_started.fetch_add(1);
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    future::rcu_ptr<routing_table>::snapshot snapshot(table);
+    int version = snapshot->version;
+    for (size_t i = 0; i < snapshot->routes.size(); ++i) {
+      if (version < 0 || snapshot->routes[i] != version * 100 + (int)i) {
+        num_errors.fetch_add(1);
+        break;
+      }
+    }
+    ++count;
+  }
+  num_reads.fetch_add(count);
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> readers;
+  for (int i = 0; i < 3; ++i) {
+    readers.push_back(new future::thread(function_bind(reader)));
+  }
+  while (num_started.load() != (int)readers.size()) {
+    future::internal::cpu_relax();
+  }
+  const int num_updates = 200;
+  for (int i = 1; i <= num_updates; ++i) {
+    table.update(new routing_table(i));
+  }
+  stop.store(1);
+  for (size_t i = 0; i < readers.size(); ++i) {
+    readers[i]->join();
+    delete readers[i];
+  }
+  {
+    future::rcu_ptr<routing_table>::snapshot snapshot(table);
+    printf("Current version: %d, updates: %d, reads: %ld\n",
+           snapshot->version, num_updates, num_reads.load());
+  }
+  if (num_errors.load() != 0) {
+    printf("Readers saw freed tables: %d\n", num_errors.load());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
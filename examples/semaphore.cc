@@ -0,0 +1,98 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <sched.h>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/semaphore.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Threads share a small number of connections guarded by a semaphore,
+ * no more than that many threads are to use them at once.
+ */
+
+enum { num_connections = 3 };
+enum { num_threads = 8 };
+enum { num_requests = 20000 };
+
+static future::counting_semaphore connections(num_connections);
+static future::internal::atomic<int> num_in_use(0);
+static future::internal::atomic<int> max_in_use(0);
+
+static void use_connection(void) {
+  int in_use = num_in_use.fetch_add(1) + 1;
+  max_in_use.fetch_max(in_use);
+  /* Let other clients in while the connection is held. */
+  sched_yield();
+  num_in_use.fetch_sub(1);
+}
+
+static void client(int index) {
+  for (int i = 0; i < num_requests; ++i) {
+    if (i % 3 == 0) {
+      if (!connections.try_acquire()) {
+        connections.acquire();
+      }
+    } else if (!connections.try_acquire_for(1000)) {
+      printf("Client %d timed out waiting for a connection\n", index);
+      continue;
+    }
+    use_connection();
+    connections.release();
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(new future::thread(function_bind(client, i)));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  printf("Most connections in use at once: %d of %d\n",
+         max_in_use.load(), (int)num_connections);
+
+  /* Take all the permits, then waiting for one more times out. */
+  connections.acquire();
+  connections.acquire();
+  connections.acquire();
+  bool timed_out = !connections.try_acquire_for(20);
+  connections.release(num_connections);
+  printf("Acquire of an exhausted semaphore timed out: %s\n",
+         timed_out ? "yes" : "no");
+
+  if (max_in_use.load() > num_connections || !timed_out ||
+      connections.available() != num_connections) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
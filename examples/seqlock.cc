@@ -0,0 +1,128 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/seqlock.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Readers check that every snapshot they get is consistent while writers
+ * keep replacing it, so a torn read would be noticed.
+ */
+
+struct quote {
+  long long bid;
+  long long ask;
+  long long sequence;
+  double spread;
+};
+
+static quote make_quote(long long sequence) {
+  quote result;
+  result.bid = sequence * 10;
+  result.ask = sequence * 10 + 5;
+  result.sequence = sequence;
+  result.spread = 5.0;
+  return result;
+}
+
+static bool is_consistent(const quote& value) {
+  return value.bid == value.sequence * 10 &&
+         value.ask == value.sequence * 10 + 5 &&
+         value.spread == 5.0;
+}
+
+enum { num_readers = 3 };
+enum { num_writes = 200000 };
+
+static future::seqlock<quote> latest(make_quote(0));
+static future::internal::atomic<int> stop(0);
+static future::internal::atomic<int> num_torn(0);
+static future::internal::atomic<long> num_reads(0);
+static future::internal::atomic<long> num_retries(0);
+
+static void reader(void) {
+  long count = 0, retries = 0;
+  while (!stop.load(future::internal::memory_order_relaxed)) {
+    quote value;
+    if (count % 2 == 0) {
+      value = latest.load();
+    } else if (!latest.try_load(&value)) {
+      ++retries;
+      continue;
+    }
+    if (!is_consistent(value)) {
+      num_torn.fetch_add(1);
+    }
+    ++count;
+  }
+  num_reads.fetch_add(count);
+  num_retries.fetch_add(retries);
+}
+
+/* Two writers: one replaces the whole value, other updates it in place. */
+static void writer(bool in_place) {
+  for (long long i = 1; i <= num_writes; ++i) {
+    if (in_place) {
+      future::seqlock<quote>::writer access(latest);
+      long long sequence = access->sequence + 1;
+      access->bid = sequence * 10;
+      access->ask = sequence * 10 + 5;
+      access->sequence = sequence;
+    } else {
+      latest.store(make_quote(i));
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<future::thread*> readers, writers;
+  for (int i = 0; i < num_readers; ++i) {
+    readers.push_back(new future::thread(function_bind(reader)));
+  }
+  writers.push_back(new future::thread(function_bind(writer, false)));
+  writers.push_back(new future::thread(function_bind(writer, true)));
+  for (size_t i = 0; i < writers.size(); ++i) {
+    writers[i]->join();
+    delete writers[i];
+  }
+  stop.store(1);
+  for (size_t i = 0; i < readers.size(); ++i) {
+    readers[i]->join();
+    delete readers[i];
+  }
+
+  quote last = latest.load();
+  printf("Reads: %ld, failed try_load: %ld, torn: %d\n",
+         num_reads.load(), num_retries.load(), num_torn.load());
+  printf("Last sequence: %lld, seqlock sequence: %u\n",
+         last.sequence, latest.sequence());
+  return num_torn.load() == 0 && is_consistent(last) ? EXIT_SUCCESS
+                                                     : EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "future/clock.h"
+#include "future/spsc_ring.h"
+
+/* Throughput of passing small messages between two threads, pinned to
+ * different CPUs when possible.
+ *
+ *   spsc_ring_benchmark [num_messages] [batch_size]
+ */
+
+typedef unsigned int message;
+
+static future::spsc_ring<message> ring(64 * 1024);
+static size_t num_messages = 100000000;
+static size_t batch_size = 256;
+
+static void pin_to_cpu(int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+    printf("Failed to pin thread to CPU %d\n", cpu);
+  }
+#else
+  (void)cpu;
+#endif
+}
+
+static void *producer(void * /*arg*/) {
+  pin_to_cpu(0);
+  size_t num_sent = 0;
+  while (num_sent < num_messages) {
+    message *slots;
+    size_t count = ring.reserve(batch_size, &slots);
+    if (count == 0) {
+      sched_yield();
+      continue;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      slots[i] = (message)(num_sent + i);
+    }
+    ring.commit(count);
+    num_sent += count;
+  }
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  pin_to_cpu(1);
+  message *batch = new message[batch_size];
+  size_t num_received = 0;
+  message checksum = 0;
+  while (num_received < num_messages) {
+    size_t count = ring.pop_n(batch, batch_size);
+    if (count == 0) {
+      sched_yield();
+      continue;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      checksum += batch[i];
+    }
+    num_received += count;
+  }
+  delete [] batch;
+  *reinterpret_cast<message*>(arg) = checksum;
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    num_messages = strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    batch_size = strtoul(argv[2], NULL, 10);
+  }
+  message checksum = 0, expected_checksum = 0;
+  for (size_t i = 0; i < num_messages; ++i) {
+    expected_checksum += (message)i;
+  }
+
+  uint64_t start_time = future::internal::monotonic_time_ns();
+  pthread_t producer_thread, consumer_thread;
+  pthread_create(&consumer_thread, NULL, consumer, &checksum);
+  pthread_create(&producer_thread, NULL, producer, NULL);
+  pthread_join(producer_thread, NULL);
+  pthread_join(consumer_thread, NULL);
+  double seconds = (future::internal::monotonic_time_ns() - start_time) / 1e9;
+
+  printf("Messages: %lu, batch size: %lu\n",
+         (unsigned long)num_messages, (unsigned long)batch_size);
+  printf("Time: %.3f sec, throughput: %.1f M messages/sec\n",
+         seconds, num_messages / seconds / 1e6);
+  if (checksum != expected_checksum) {
+    printf("Checksum mismatch!\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/striped_mutex.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+/* Transfers between random accounts guarded by a striped lock, total
+ * balance is to stay zero.
+ */
+
+enum { num_accounts = 1000 };
+enum { num_transfers = 200000 };
+
+typedef future::striped_mutex<64> account_locks;
+
+static account_locks locks("accounts");
+static long balances[num_accounts];
+
+static void transfer(unsigned int seed) {
+  for (int i = 0; i < num_transfers; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int from = (seed >> 8) % num_accounts;
+    int to = (seed >> 20) % num_accounts;
+    if (i % 4 == 0) {
+      account_locks::scoped_lock lock(locks, from);
+      balances[from] += 0;
+    } else if (i % 4 == 1) {
+      int accounts[3] = {from, to, (int)(seed % num_accounts)};
+      account_locks::multi_lock lock(locks, accounts, 3);
+      balances[accounts[0]] -= 2;
+      balances[accounts[1]] += 1;
+      balances[accounts[2]] += 1;
+    } else {
+      account_locks::multi_lock lock(locks, from, to);
+      balances[from] -= 1;
+      balances[to] += 1;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  for (size_t i = 0; i < locks.size(); ++i) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(&locks.stripe_mutex(i));
+    if (address % FUTURE_CACHELINE_SIZE != 0) {
+      printf("Stripe %d is not aligned to the cache line\n", (int)i);
+      return EXIT_FAILURE;
+    }
+  }
+  printf("Stripe of key \"account\": %d\n",
+         (int)locks.index_of(std::string("account")));
+
+  std::vector<future::thread*> threads;
+  for (unsigned int i = 0; i < 4; ++i) {
+    threads.push_back(new future::thread(function_bind(transfer, i + 1)));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  long total = 0;
+  for (int i = 0; i < num_accounts; ++i) {
+    total += balances[i];
+  }
+  printf("Total balance: %ld\n", total);
+
+  locks.lock_all();
+  locks.unlock_all();
+  return total == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
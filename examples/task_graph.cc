@@ -0,0 +1,132 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/latch.h"
+#include "future/task_graph.h"
+#include "future/thread_pool.h"
+
+using future::bind::function_bind;
+
+static future::internal::atomic<int> step(0);
+static future::internal::atomic<int> num_errors(0);
+
+/* Checks the node runs after the given number of nodes finished at least. */
+static void stage(const char *name, int min_step) {
+  if (step.load() < min_step) {
+    num_errors.fetch_add(1);
+  }
+  step.fetch_add(1);
+  printf("Stage %s\n", name);
+}
+
+static void count(future::internal::atomic<int> *counter) {
+  counter->fetch_add(1);
+}
+
+/* Root with a fan of children, run by a pool task. Helpers for the children
+ * are queued behind the very task which waits for the graph.
+ */
+static void run_fan(future::thread_pool *pool,
+                    future::internal::atomic<int> *counter,
+                    future::internal::atomic<int> *num_rejected,
+                    future::latch *done) {
+  future::task_graph fan;
+  future::task_graph::node_id root = fan.add_node(function_bind(count,
+                                                                counter));
+  for (int i = 0; i < 4; ++i) {
+    fan.add_dependency(root, fan.add_node(function_bind(count, counter)));
+  }
+  for (int i = 0; i < 10; ++i) {
+    if (!fan.run(pool)) {
+      num_rejected->fetch_add(1);
+    }
+  }
+  done->count_down();
+}
+
+int main(int argc, char **argv) {
+  future::thread_pool pool(2);
+
+  /* Diamond: load, then parse and index in parallel, then report. */
+  future::task_graph graph;
+  future::task_graph::node_id load =
+      graph.add_node(function_bind(stage, "load", 0));
+  future::task_graph::node_id parse =
+      graph.add_node(function_bind(stage, "parse", 1));
+  future::task_graph::node_id index =
+      graph.add_node(function_bind(stage, "index", 1));
+  future::task_graph::node_id report =
+      graph.add_node(function_bind(stage, "report", 3));
+  graph.add_dependency(load, parse);
+  graph.add_dependency(load, index);
+  graph.add_dependency(parse, report);
+  graph.add_dependency(index, report);
+  for (int i = 0; i < 3; ++i) {
+    step.store(0);
+    if (!graph.run(&pool)) {
+      printf("Acyclic graph was rejected\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Graph which has a root but also a cycle is rejected instead of hanging
+   * forever.
+   */
+  future::task_graph cyclic;
+  future::task_graph::node_id first =
+      cyclic.add_node(function_bind(stage, "first", 0));
+  future::task_graph::node_id second =
+      cyclic.add_node(function_bind(stage, "second", 0));
+  future::task_graph::node_id third =
+      cyclic.add_node(function_bind(stage, "third", 0));
+  cyclic.add_dependency(first, second);
+  cyclic.add_dependency(second, third);
+  cyclic.add_dependency(third, second);
+  printf("Cyclic graph has a cycle: %s\n", cyclic.has_cycle() ? "yes" : "no");
+  if (cyclic.run(&pool)) {
+    printf("Cyclic graph was run\n");
+    return EXIT_FAILURE;
+  }
+
+  /* Graph run from a worker of a single threaded pool. */
+  future::internal::atomic<int> num_fan_nodes(0), num_rejected(0);
+  {
+    future::thread_pool single_pool(1);
+    future::latch done(1);
+    single_pool.submit(function_bind(run_fan, &single_pool, &num_fan_nodes,
+                                     &num_rejected, &done));
+    done.wait();
+  }
+  printf("Graph run from a pool worker finished %d nodes\n",
+         num_fan_nodes.load());
+  if (num_fan_nodes.load() != 50 || num_rejected.load() != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return num_errors.load() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/cpu_topology.h"
+#include "future/function.h"
+#include "future/thread.h"
+
+using future::bind::function_bind;
+
+static void print_cpus(const char *title, const future::cpu_set& cpus) {
+  std::vector<int> indices = cpus.to_vector();
+  printf("%s", title);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    printf("%s%d", i == 0 ? "" : ",", indices[i]);
+  }
+  printf("\n");
+}
+
+static void worker(int index) {
+  printf("Hello from thread %d\n", index);
+}
+
+int main(int argc, char **argv) {
+  const future::cpu_topology& topology = future::cpu_topology::system();
+  printf("CPUs: %d, cores: %d, packages: %d\n",
+         topology.num_cpus(),
+         topology.num_cores(),
+         topology.num_packages());
+  for (size_t i = 0; i < topology.caches().size(); ++i) {
+    const future::cpu_topology::cache_info& cache = topology.caches()[i];
+    char title[64];
+    snprintf(title, sizeof(title), "L%d %s %dK shared by: ",
+             cache.level, cache.type.c_str(), (int)(cache.size / 1024));
+    print_cpus(title, cache.shared_cpus);
+  }
+  print_cpus("One CPU per core: ", topology.one_cpu_per_core());
+
+  /* Start a thread per core with a small stack, pinned to its core. */
+  std::vector<int> cpus = topology.one_cpu_per_core().to_vector();
+  std::vector<future::thread*> threads;
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    future::thread *thread =
+        new future::thread(function_bind(worker, (int)i), 64 * 1024);
+    future::cpu_set affinity;
+    affinity.add(cpus[i]);
+    thread->set_affinity(affinity);
+    thread->set_name("example-worker");
+    threads.push_back(thread);
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/mutex.h"
+#include "future/thread_pool.h"
+
+using future::bind::function_bind;
+
+static future::mutex result_mutex;
+static long long result = 0;
+
+static void accumulate(int value) {
+  future::mutex::scoped_lock lock(result_mutex);
+  result += value;
+}
+
+static void spawn_range(future::thread_pool *pool, int begin, int end) {
+  /* Split the range until it's small enough, sub-ranges are pushed to the
+   * local deque of the worker and are stolen by idle workers.
+   */
+  if (end - begin > 1000) {
+    int middle = begin + (end - begin) / 2;
+    pool->submit(function_bind(spawn_range, pool, begin, middle));
+    pool->submit(function_bind(spawn_range, pool, middle, end));
+    return;
+  }
+  long long sum = 0;
+  for (int i = begin; i < end; ++i) {
+    sum += i;
+  }
+  accumulate((int)(sum % 1000003));
+}
+
+int main(int argc, char **argv) {
+  {
+    future::thread_pool pool;
+    printf("Running on %d threads\n", pool.num_threads());
+    for (int i = 0; i < 10; ++i) {
+      pool.submit(function_bind(accumulate, i));
+    }
+    pool.submit(function_bind(spawn_range, &pool, 0, 1000000));
+  }
+  printf("Result is: %lld\n", result);
+  return EXIT_SUCCESS;
+}
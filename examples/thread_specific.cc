@@ -0,0 +1,103 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/thread.h"
+#include "future/thread_specific.h"
+
+using future::bind::function_bind;
+
+/* Per-thread scratch buffers and counters. Buffers left in threads are
+ * cleaned up when the threads exit.
+ */
+
+struct scratch_buffer {
+  explicit scratch_buffer(int owner) : owner(owner), data(1024) {}
+
+  int owner;
+  std::vector<char> data;
+};
+
+static future::internal::atomic<int> num_cleanups(0);
+static future::internal::atomic<int> num_errors(0);
+
+static void cleanup_buffer(scratch_buffer *buffer) {
+  num_cleanups.fetch_add(1);
+  delete buffer;
+}
+
+static future::thread_specific_ptr<scratch_buffer> buffer(cleanup_buffer);
+static future::thread_local_value<long> counter(0);
+static future::internal::atomic<long> total(0);
+
+static void worker(int index) {
+  if (buffer.get() != NULL) {
+    num_errors.fetch_add(1);
+  }
+  buffer.reset(new scratch_buffer(index));
+  for (int i = 0; i < 1000; ++i) {
+    ++*counter;
+    /* Every thread sees only its own buffer. */
+    if (buffer->owner != index) {
+      num_errors.fetch_add(1);
+    }
+  }
+  total.fetch_add(counter.get());
+}
+
+int main(int argc, char **argv) {
+  const int num_threads = 4;
+  std::vector<future::thread*> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(new future::thread(function_bind(worker, i)));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  printf("Total count: %ld, buffers cleaned up at thread exit: %d\n",
+         total.load(), num_cleanups.load());
+
+  /* Slot of a destroyed pointer is reused, new pointer doesn't see the
+   * value of the old one.
+   */
+  future::thread_specific_ptr<int> *first =
+      new future::thread_specific_ptr<int>();
+  first->reset(new int(1));
+  delete first;
+  future::thread_specific_ptr<int> second;
+  printf("Reused slot is empty: %s\n", second.get() == NULL ? "yes" : "no");
+
+  if (total.load() != num_threads * 1000 ||
+      num_cleanups.load() != num_threads ||
+      num_errors.load() != 0 ||
+      second.get() != NULL) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/clock.h"
+#include "future/cancellation.h"
+#include "future/function.h"
+#include "future/latch.h"
+#include "future/thread_pool.h"
+#include "future/timer_service.h"
+
+using future::bind::function_bind;
+
+/* Drives the timing wheel tick by tick and checks every timer expires
+ * exactly at its tick, including timers cascaded from the upper levels.
+ */
+static bool check_wheel(void) {
+  const uint64_t delays[] = {1, 255, 256, 257, 300, 511, 65535, 65536,
+                             65537, 70000, 16777216 + 3};
+  const size_t num_delays = sizeof(delays) / sizeof(*delays);
+  const uint64_t start_tick = 1000;
+  future::internal::timer_wheel wheel(start_tick);
+  std::vector<future::internal::timer_node> nodes(num_delays);
+  for (size_t i = 0; i < num_delays; ++i) {
+    nodes[i].expiry_tick = start_tick + delays[i];
+    nodes[i].index = (uint32_t)i;
+    wheel.insert(&nodes[i]);
+  }
+  size_t num_expired = 0;
+  std::vector<future::internal::timer_node*> expired;
+  while (wheel.num_timers() != 0) {
+    wheel.advance(&expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+      if (expired[i]->expiry_tick != wheel.current_tick()) {
+        printf("Timer %d expired at tick %lu instead of %lu\n",
+               (int)expired[i]->index,
+               (unsigned long)wheel.current_tick(),
+               (unsigned long)expired[i]->expiry_tick);
+        return false;
+      }
+    }
+    num_expired += expired.size();
+    expired.clear();
+  }
+  printf("Wheel expired %d timers on time\n", (int)num_expired);
+  return num_expired == num_delays;
+}
+
+/* Timer further than the top level covers keeps its expiry tick instead of
+ * being pulled in, ticking all the way to it would take too long here.
+ */
+static bool check_far_timer(void) {
+  const uint64_t start_tick = 1000;
+  const uint64_t far_expiry_tick = start_tick + (1ULL << 40);
+  future::internal::timer_wheel wheel(start_tick);
+  future::internal::timer_node node;
+  node.expiry_tick = far_expiry_tick;
+  wheel.insert(&node);
+  bool ok = node.expiry_tick == far_expiry_tick &&
+            node.level == future::internal::timer_wheel::num_levels - 1;
+  wheel.remove(&node);
+  printf("Far timer keeps its expiry: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+static void hold_worker(future::latch *blocked, future::latch *gate) {
+  blocked->count_down();
+  gate->wait();
+}
+
+static uint64_t start_ns;
+static future::internal::atomic<int> num_fired(0);
+static future::internal::atomic<int> num_early(0);
+static future::internal::atomic<int> num_periodic(0);
+
+static void one_shot(uint64_t delay_ms) {
+  uint64_t elapsed_ms =
+      (future::internal::monotonic_time_ns() - start_ns) / 1000000;
+  if (elapsed_ms < delay_ms) {
+    num_early.fetch_add(1);
+  }
+  num_fired.fetch_add(1);
+}
+
+static void cancelled(void) {
+  printf("Cancelled timer fired\n");
+  num_early.fetch_add(1);
+}
+
+static void periodic(void) {
+  num_periodic.fetch_add(1);
+}
+
+/* Token cancelled after the timer expired but before the executor got to
+ * the function still prevents it from running.
+ */
+static bool check_cancel_after_expiry(void) {
+  int num_before = num_early.load();
+  {
+    future::thread_pool pool(1);
+    future::timer_service timers(&pool);
+    future::cancellation_source source;
+    future::latch blocked(1), gate(1);
+    pool.submit(function_bind(hold_worker, &blocked, &gate));
+    blocked.wait();
+    timers.schedule_after(1, function_bind(cancelled), source.token());
+    while (timers.num_timers() != 0) {
+      usleep(1000);
+    }
+    source.cancel();
+    gate.count_down();
+  }
+  return num_early.load() == num_before;
+}
+
+int main(int argc, char **argv) {
+  if (!check_wheel() || !check_far_timer() ||
+      !check_cancel_after_expiry()) {
+    return EXIT_FAILURE;
+  }
+
+  future::thread_pool pool(2);
+  future::timer_service timers(&pool);
+  start_ns = future::internal::monotonic_time_ns();
+  timers.schedule_after(20, function_bind(one_shot, (uint64_t)20));
+  timers.schedule_after(50, function_bind(one_shot, (uint64_t)50));
+  future::timer_service::timer_id cancelled_id =
+      timers.schedule_after(30, function_bind(cancelled));
+  future::timer_service::timer_id periodic_id =
+      timers.schedule_every(10, function_bind(periodic));
+  if (!timers.cancel(cancelled_id)) {
+    printf("Failed to cancel a pending timer\n");
+    return EXIT_FAILURE;
+  }
+
+  usleep(120 * 1000);
+  timers.cancel(periodic_id);
+  int num_periodic_at_cancel = num_periodic.load();
+  usleep(50 * 1000);
+
+  printf("One-shot timers fired: %d, early: %d\n",
+         num_fired.load(), num_early.load());
+  printf("Periodic timer fired %d times, after cancel: %d\n",
+         num_periodic_at_cancel,
+         num_periodic.load() - num_periodic_at_cancel);
+  printf("Second cancel of a cancelled timer: %d\n",
+         (int)timers.cancel(cancelled_id));
+
+  /* Invocation already submitted to the pool may still finish after
+   * cancel(), but no new ones are expected.
+   */
+  if (num_fired.load() != 2 || num_early.load() != 0 ||
+      num_periodic_at_cancel == 0 ||
+      num_periodic.load() - num_periodic_at_cancel > 1) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_ATOMIC_H_
+#define FUTURE_ATOMIC_H_
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#  error "No atomic operations implementation for this compiler"
+#endif
+
+namespace future {
+namespace internal {
+
+/* Size of the cache line, used to keep frequently modified fields of
+ * concurrent structures from sharing a line with each other.
+ */
+#define FUTURE_CACHELINE_SIZE 64
+
+enum memory_order {
+  memory_order_relaxed = __ATOMIC_RELAXED,
+  memory_order_consume = __ATOMIC_CONSUME,
+  memory_order_acquire = __ATOMIC_ACQUIRE,
+  memory_order_release = __ATOMIC_RELEASE,
+  memory_order_acq_rel = __ATOMIC_ACQ_REL,
+  memory_order_seq_cst = __ATOMIC_SEQ_CST
+};
+
+/* Minimal atomic wrapper around compiler builtins, covers integral and
+ * pointer types which fit into a machine word (or two on 32bit platforms).
+ */
+template <typename T>
+class atomic {
+ public:
+  atomic() : value_(T()) {}
+
+  explicit atomic(T value) : value_(value) {}
+
+  inline T load(memory_order order = memory_order_seq_cst) const {
+    return __atomic_load_n(&value_, order);
+  }
+
+  inline void store(T value, memory_order order = memory_order_seq_cst) {
+    __atomic_store_n(&value_, value, order);
+  }
+
+  inline T exchange(T value, memory_order order = memory_order_seq_cst) {
+    return __atomic_exchange_n(&value_, value, order);
+  }
+
+  /* Updates expected with the current value on failure. */
+  inline bool compare_exchange_strong(
+      T& expected,
+      T desired,
+      memory_order order = memory_order_seq_cst) {
+    return __atomic_compare_exchange_n(&value_, &expected, desired, false,
+                                       order, failure_order(order));
+  }
+
+  inline bool compare_exchange_weak(
+      T& expected,
+      T desired,
+      memory_order order = memory_order_seq_cst) {
+    return __atomic_compare_exchange_n(&value_, &expected, desired, true,
+                                       order, failure_order(order));
+  }
+
+  inline T fetch_add(T value, memory_order order = memory_order_seq_cst) {
+    return __atomic_fetch_add(&value_, value, order);
+  }
+
+  inline T fetch_sub(T value, memory_order order = memory_order_seq_cst) {
+    return __atomic_fetch_sub(&value_, value, order);
+  }
+
+  inline T fetch_or(T value, memory_order order = memory_order_seq_cst) {
+    return __atomic_fetch_or(&value_, value, order);
+  }
+
+  inline T fetch_and(T value, memory_order order = memory_order_seq_cst) {
+    return __atomic_fetch_and(&value_, value, order);
+  }
+
+  /* Raises stored value to the given one if it's bigger, returns the
+   * previous value.
+   */
+  inline T fetch_max(T value, memory_order order = memory_order_relaxed) {
+    T current = load(memory_order_relaxed);
+    while (current < value &&
+           !compare_exchange_weak(current, value, order)) {
+    }
+    return current;
+  }
+
+  /* Address of the underlying storage, used for futex waits. */
+  inline T *address() {
+    return &value_;
+  }
+
+ protected:
+  static inline memory_order failure_order(memory_order order) {
+    switch (order) {
+      case memory_order_release: return memory_order_relaxed;
+      case memory_order_acq_rel: return memory_order_acquire;
+      default: return order;
+    }
+  }
+
+  /* Atomics are not copyable. */
+  atomic(const atomic& other);
+  void operator=(const atomic& other);
+
+  T value_;
+};
+
+inline void atomic_thread_fence(memory_order order) {
+  __atomic_thread_fence(order);
+}
+
+/* Hint for the CPU that we're in a spin-wait loop. */
+inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+}  /* namespace internal */
+}  /* namespace future */
+
+#endif  /* FUTURE_ATOMIC_H_ */
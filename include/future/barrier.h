@@ -0,0 +1,137 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_BARRIER_H_
+#define FUTURE_BARRIER_H_
+
+#include <cassert>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/futex.h"
+
+namespace future {
+
+/* Reusable barrier for a fixed number of threads.
+ *
+ * Threads arriving early spin for a short while and then sleep on a futex.
+ * The optional completion function is run once per phase by the last
+ * arriving thread, before any of the threads is released.
+ */
+class barrier {
+ public:
+  typedef function::function<void(void)> function_type;
+
+  explicit barrier(int num_threads)
+      : num_threads_(num_threads),
+        has_completion_(false),
+        remaining_(num_threads),
+        phase_(0) {
+    assert(num_threads > 0);
+  }
+
+  barrier(int num_threads, function_type completion)
+      : num_threads_(num_threads),
+        completion_(completion),
+        has_completion_(true),
+        remaining_(num_threads),
+        phase_(0) {
+    assert(num_threads > 0);
+  }
+
+  /* Returns true in exactly one thread of every phase, the one which
+   * completed the phase.
+   */
+  bool arrive_and_wait() {
+    using internal::memory_order_acquire;
+    using internal::memory_order_acq_rel;
+    using internal::memory_order_relaxed;
+    int phase = phase_.load(memory_order_acquire) & ~has_sleepers;
+    if (remaining_.fetch_sub(1, memory_order_acq_rel) == 1) {
+      if (has_completion_) {
+        completion_();
+      }
+      /* Reset the counter before releasing anyone, so threads arriving to
+       * the next phase count down from the start. Nothing is accessed
+       * after the phase is bumped, released threads might destroy the
+       * barrier right away.
+       */
+      remaining_.store(num_threads_, memory_order_relaxed);
+      int next_phase = (int)((unsigned int)phase + phase_increment);
+      int previous = phase_.exchange(next_phase,
+                                     memory_order_acq_rel);
+      if (previous & has_sleepers) {
+        internal::futex_wake_all(phase_.address());
+      }
+      return true;
+    }
+    for (int i = 0; i < num_spins; ++i) {
+      if ((phase_.load(memory_order_acquire) & ~has_sleepers) != phase) {
+        return false;
+      }
+      internal::cpu_relax();
+    }
+    for (;;) {
+      int current = phase_.load(memory_order_acquire);
+      if ((current & ~has_sleepers) != phase) {
+        return false;
+      }
+      if ((current & has_sleepers) == 0 &&
+          !phase_.compare_exchange_strong(current, current | has_sleepers,
+                                          memory_order_acq_rel)) {
+        continue;
+      }
+      internal::futex_wait(phase_.address(), phase | has_sleepers);
+    }
+  }
+
+  int num_threads() const {
+    return num_threads_;
+  }
+
+ protected:
+  enum { num_spins = 1024 };
+
+  /* Lowest bit of the phase word tells whether anyone is sleeping on it. */
+  enum {
+    has_sleepers = 1,
+    phase_increment = 2
+  };
+
+  int num_threads_;
+  function_type completion_;
+  bool has_completion_;
+
+  internal::atomic<int> remaining_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  /* Phase counter, this is the word threads sleep on. */
+  internal::atomic<int> phase_;
+
+ private:
+  barrier(const barrier& other);
+  void operator=(const barrier& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_BARRIER_H_ */
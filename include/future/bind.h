@@ -34,7 +34,7 @@ namespace internal {
 template<typename FuncPointer, typename R>
 class function_bind : public ::future::internal::function_bind_base<R> {
   typedef ::future::internal::function_bind_base<R> base_type;
-  typedef future::internal::argument_list argument_list_type;
+  typedef ::future::internal::argument_list argument_list_type;
  public:
   function_bind() : base_type(),
                     func_(NULL) {}
@@ -58,7 +58,7 @@ class function_bind : public ::future::internal::function_bind_base<R> {
   }
 
  protected:
-  typedef future::internal::argument_wrapper_base argument_wrapper_base;
+  typedef ::future::internal::argument_wrapper_base argument_wrapper_base;
   argument_wrapper_base *get_(argument_list_type& argument_list,
                               int index) {
     argument_wrapper_base *arg = argument_list_[index];
@@ -76,8 +76,8 @@ class function_bind : public ::future::internal::function_bind_base<R> {
 #define FUNCTION_GLUE(a, b) a ## b
 #define FUNCTION_BIND_DECLARE_COMMON(n) \
   typedef ::future::internal::function_bind_base<R> base_type; \
-  typedef future::internal::argument_list argument_list_type; \
-  typedef future::internal::argument_wrapper_base argument_wrapper_base; \
+  typedef ::future::internal::argument_list argument_list_type; \
+  typedef ::future::internal::argument_wrapper_base argument_wrapper_base; \
  public: \
   explicit FUNCTION_GLUE(function_bind, n)(FuncPointer func) \
   : function_bind<FuncPointer, R>(func, n) {} \
@@ -305,8 +305,8 @@ class function_bind10 : public function_bind<FuncPointer, R> {
 
 #define CLASS_METHOD_BIND_DECLARE_COMMON(n) \
   typedef ::future::internal::function_bind_base<R> base_type; \
-  typedef future::internal::argument_list argument_list_type; \
-  typedef future::internal::argument_wrapper_base argument_wrapper_base; \
+  typedef ::future::internal::argument_list argument_list_type; \
+  typedef ::future::internal::argument_wrapper_base argument_wrapper_base; \
   C *object_; \
  public: \
   explicit FUNCTION_GLUE(class_method_bind, n)(FuncPointer func, \
@@ -0,0 +1,234 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_BLOCKING_QUEUE_H_
+#define FUTURE_BLOCKING_QUEUE_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "future/clock.h"
+#include "future/condition_variable.h"
+#include "future/mutex.h"
+
+namespace future {
+
+/* Queue protected by a mutex, optionally bounded.
+ *
+ * Batch operations move any number of values under a single lock
+ * acquisition. Condition variables are only signalled when the queue goes
+ * from empty to non-empty (or from full to non-full) and somebody is
+ * waiting; a woken up thread passes the signal on if there is still
+ * something left for other waiters.
+ */
+template <typename T>
+class blocking_queue {
+ public:
+  /* Zero capacity means the queue is unbounded. */
+  explicit blocking_queue(size_t capacity = 0)
+      : mutex_("blocking_queue"),
+        capacity_(capacity),
+        num_pop_waiters_(0),
+        num_push_waiters_(0) {}
+
+  /* Blocks while the queue is full. */
+  void push(const T& value) {
+    push_many(&value, &value + 1);
+  }
+
+  /* Returns false if the queue is full. */
+  bool try_push(const T& value) {
+    mutex::scoped_lock lock(mutex_);
+    if (num_free() == 0) {
+      return false;
+    }
+    bool was_empty = queue_.empty();
+    queue_.push_back(value);
+    notify_not_empty(was_empty);
+    return true;
+  }
+
+  /* Push all the values, blocking while the queue is full. Values are
+   * pushed in as few lock acquisitions as the capacity allows.
+   */
+  template <typename Iterator>
+  void push_many(Iterator first, Iterator last) {
+    mutex::scoped_lock lock(mutex_);
+    while (first != last) {
+      while (num_free() == 0) {
+        ++num_push_waiters_;
+        not_full_.wait(lock);
+        --num_push_waiters_;
+      }
+      bool was_empty = queue_.empty();
+      for (size_t n = num_free(); n != 0 && first != last; --n, ++first) {
+        queue_.push_back(*first);
+      }
+      notify_not_empty(was_empty);
+      pass_not_full();
+    }
+  }
+
+  /* Blocks while the queue is empty. */
+  void pop(T *value) {
+    mutex::scoped_lock lock(mutex_);
+    wait_not_empty(lock);
+    bool was_full = is_full();
+    *value = queue_.front();
+    queue_.pop_front();
+    notify_not_full(was_full);
+    pass_not_empty();
+  }
+
+  /* Returns false if the queue is empty. */
+  bool try_pop(T *value) {
+    mutex::scoped_lock lock(mutex_);
+    if (queue_.empty()) {
+      return false;
+    }
+    bool was_full = is_full();
+    *value = queue_.front();
+    queue_.pop_front();
+    notify_not_full(was_full);
+    return true;
+  }
+
+  /* Wait for the queue to become non-empty and move all the values to the
+   * end of the given vector. Returns number of values taken.
+   */
+  size_t pop_all(std::vector<T> *values) {
+    mutex::scoped_lock lock(mutex_);
+    wait_not_empty(lock);
+    return take(queue_.size(), values);
+  }
+
+  /* Wait up to timeout_ms for the queue to become non-empty and move up to
+   * max_count values to the end of the given vector. Returns number of
+   * values taken, which is zero on timeout.
+   */
+  size_t pop_up_to(size_t max_count,
+                   uint64_t timeout_ms,
+                   std::vector<T> *values) {
+    mutex::scoped_lock lock(mutex_);
+    if (queue_.empty() && timeout_ms != 0) {
+      uint64_t deadline = internal::monotonic_time_ns() +
+                          timeout_ms * 1000000ULL;
+      ++num_pop_waiters_;
+      while (queue_.empty()) {
+        uint64_t now = internal::monotonic_time_ns();
+        if (now >= deadline) {
+          break;
+        }
+        not_empty_.wait_for(lock, (deadline - now + 999999) / 1000000);
+      }
+      --num_pop_waiters_;
+    }
+    size_t count = take(std::min(max_count, queue_.size()), values);
+    pass_not_empty();
+    return count;
+  }
+
+  size_t size() {
+    mutex::scoped_lock lock(mutex_);
+    return queue_.size();
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+ protected:
+  inline size_t num_free() const {
+    if (capacity_ == 0) {
+      return (size_t)-1;
+    }
+    return capacity_ - std::min(capacity_, queue_.size());
+  }
+
+  inline bool is_full() const {
+    return capacity_ != 0 && queue_.size() >= capacity_;
+  }
+
+  void wait_not_empty(mutex::scoped_lock& lock) {
+    while (queue_.empty()) {
+      ++num_pop_waiters_;
+      not_empty_.wait(lock);
+      --num_pop_waiters_;
+    }
+  }
+
+  size_t take(size_t count, std::vector<T> *values) {
+    if (count == 0) {
+      return 0;
+    }
+    bool was_full = is_full();
+    values->insert(values->end(), queue_.begin(), queue_.begin() + count);
+    queue_.erase(queue_.begin(), queue_.begin() + count);
+    notify_not_full(was_full);
+    return count;
+  }
+
+  /* Signalling on transitions, mutex is to be locked. */
+
+  inline void notify_not_empty(bool was_empty) {
+    if (was_empty && !queue_.empty() && num_pop_waiters_ != 0) {
+      not_empty_.notify_one();
+    }
+  }
+
+  inline void notify_not_full(bool was_full) {
+    if (was_full && !is_full() && num_push_waiters_ != 0) {
+      not_full_.notify_one();
+    }
+  }
+
+  inline void pass_not_empty() {
+    if (!queue_.empty() && num_pop_waiters_ != 0) {
+      not_empty_.notify_one();
+    }
+  }
+
+  inline void pass_not_full() {
+    if (!is_full() && num_push_waiters_ != 0) {
+      not_full_.notify_one();
+    }
+  }
+
+  mutex mutex_;
+  condition_variable not_empty_;
+  condition_variable not_full_;
+  std::deque<T> queue_;
+  size_t capacity_;
+  int num_pop_waiters_;
+  int num_push_waiters_;
+
+ private:
+  blocking_queue(const blocking_queue& other);
+  void operator=(const blocking_queue& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_BLOCKING_QUEUE_H_ */
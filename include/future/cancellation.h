@@ -0,0 +1,315 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_CANCELLATION_H_
+#define FUTURE_CANCELLATION_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <pthread.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <cassert>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/condition_variable.h"
+#include "future/function.h"
+#include "future/mutex.h"
+
+namespace future {
+
+class cancellation_registration;
+
+namespace internal {
+
+/* State shared by the source, its tokens and registrations. The flag is
+ * all the polling side ever looks at, the mutex only guards the list of
+ * callbacks.
+ */
+class cancellation_state {
+ public:
+  cancellation_state()
+      : cancelled_(0),
+        num_references_(1),
+        mutex_("cancellation"),
+        callbacks_(NULL),
+        running_(NULL) {}
+
+  inline void add_reference() {
+    num_references_.fetch_add(1, memory_order_relaxed);
+  }
+
+  inline void release() {
+    if (num_references_.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  inline bool is_cancelled() const {
+    return cancelled_.load(memory_order_acquire) != 0;
+  }
+
+  /* Runs the callbacks in the calling thread, returns false if the state
+   * was cancelled already.
+   */
+  bool cancel();
+
+  /* Returns false if the state is cancelled already, in which case the
+   * callback is to be run by the caller.
+   */
+  bool add_callback(cancellation_registration *registration);
+
+  /* Waits for the callback to finish if it's being run by another thread. */
+  void remove_callback(cancellation_registration *registration);
+
+ protected:
+  atomic<int> cancelled_;
+  atomic<int> num_references_;
+
+  mutex mutex_;
+  condition_variable callback_finished_;
+  cancellation_registration *callbacks_;
+  /* Registration of the callback which is currently being run, and the
+   * thread which runs it.
+   */
+  cancellation_registration *running_;
+  pthread_t running_thread_;
+
+ private:
+  cancellation_state(const cancellation_state& other);
+  void operator=(const cancellation_state& other);
+};
+
+}  /* namespace internal */
+
+/* Read-only view of a cancellation_source, cheap to copy and to poll.
+ * Default constructed token is never cancelled.
+ */
+class cancellation_token {
+ public:
+  cancellation_token() : state_(NULL) {}
+
+  cancellation_token(const cancellation_token& other)
+      : state_(other.state_) {
+    if (state_ != NULL) {
+      state_->add_reference();
+    }
+  }
+
+  ~cancellation_token() {
+    if (state_ != NULL) {
+      state_->release();
+    }
+  }
+
+  void operator=(const cancellation_token& other) {
+    if (other.state_ != NULL) {
+      other.state_->add_reference();
+    }
+    if (state_ != NULL) {
+      state_->release();
+    }
+    state_ = other.state_;
+  }
+
+  /* Long running tasks are to poll this and stop early. */
+  bool is_cancelled() const {
+    return state_ != NULL && state_->is_cancelled();
+  }
+
+  bool can_be_cancelled() const {
+    return state_ != NULL;
+  }
+
+ protected:
+  friend class cancellation_source;
+  friend class cancellation_registration;
+
+  /* Takes ownership over the state reference. */
+  explicit cancellation_token(internal::cancellation_state *state)
+      : state_(state) {}
+
+  internal::cancellation_state *state_;
+};
+
+/* Side which requests cancellation of the work holding its tokens. */
+class cancellation_source {
+ public:
+  cancellation_source() : state_(new internal::cancellation_state()) {}
+
+  ~cancellation_source() {
+    state_->release();
+  }
+
+  cancellation_token token() const {
+    state_->add_reference();
+    return cancellation_token(state_);
+  }
+
+  /* Sets the flag and runs the registered callbacks in the calling thread.
+   * Returns false if cancellation was requested already.
+   */
+  bool cancel() {
+    return state_->cancel();
+  }
+
+  bool is_cancelled() const {
+    return state_->is_cancelled();
+  }
+
+ protected:
+  internal::cancellation_state *state_;
+
+ private:
+  cancellation_source(const cancellation_source& other);
+  void operator=(const cancellation_source& other);
+};
+
+/* Callback which is run once the token is cancelled, or right away if it
+ * is cancelled already. Destructor unregisters the callback and waits for
+ * it to finish if it's running in another thread.
+ */
+class cancellation_registration {
+ public:
+  typedef function::function<void(void)> function_type;
+
+  cancellation_registration(const cancellation_token& token,
+                            function_type callback)
+      : state_(token.state_),
+        callback_(callback),
+        prev_(NULL),
+        next_(NULL),
+        registered_(false),
+        added_(false) {
+    if (state_ == NULL) {
+      return;
+    }
+    state_->add_reference();
+    added_ = state_->add_callback(this);
+    if (!added_) {
+      callback_();
+    }
+  }
+
+  ~cancellation_registration() {
+    if (state_ == NULL) {
+      return;
+    }
+    /* Whether the callback is still registered or is being run right now
+     * is only known under the state mutex.
+     */
+    if (added_) {
+      state_->remove_callback(this);
+    }
+    state_->release();
+  }
+
+ protected:
+  friend class internal::cancellation_state;
+
+  internal::cancellation_state *state_;
+  function_type callback_;
+  cancellation_registration *prev_;
+  cancellation_registration *next_;
+  /* Guarded by the state mutex. */
+  bool registered_;
+  /* Callback was added to the state, only accessed by the owner. */
+  bool added_;
+
+ private:
+  cancellation_registration(const cancellation_registration& other);
+  void operator=(const cancellation_registration& other);
+};
+
+namespace internal {
+
+inline bool cancellation_state::cancel() {
+  mutex::scoped_lock lock(mutex_);
+  if (cancelled_.load(memory_order_relaxed) != 0) {
+    return false;
+  }
+  cancelled_.store(1, memory_order_release);
+  running_thread_ = pthread_self();
+  while (callbacks_ != NULL) {
+    cancellation_registration *registration = callbacks_;
+    callbacks_ = registration->next_;
+    if (callbacks_ != NULL) {
+      callbacks_->prev_ = NULL;
+    }
+    registration->registered_ = false;
+    running_ = registration;
+    lock.unlock();
+    registration->callback_();
+    lock.lock();
+    running_ = NULL;
+    callback_finished_.notify_all();
+  }
+  return true;
+}
+
+inline bool cancellation_state::add_callback(
+    cancellation_registration *registration) {
+  mutex::scoped_lock lock(mutex_);
+  if (cancelled_.load(memory_order_relaxed) != 0) {
+    return false;
+  }
+  registration->next_ = callbacks_;
+  if (callbacks_ != NULL) {
+    callbacks_->prev_ = registration;
+  }
+  callbacks_ = registration;
+  registration->registered_ = true;
+  return true;
+}
+
+inline void cancellation_state::remove_callback(
+    cancellation_registration *registration) {
+  mutex::scoped_lock lock(mutex_);
+  if (registration->registered_) {
+    if (registration->prev_ != NULL) {
+      registration->prev_->next_ = registration->next_;
+    } else {
+      callbacks_ = registration->next_;
+    }
+    if (registration->next_ != NULL) {
+      registration->next_->prev_ = registration->prev_;
+    }
+    registration->registered_ = false;
+    return;
+  }
+  /* Callback might unregister itself, no waiting in that case. */
+  if (running_ == registration &&
+      pthread_equal(running_thread_, pthread_self())) {
+    return;
+  }
+  while (running_ == registration) {
+    callback_finished_.wait(lock);
+  }
+}
+
+}  /* namespace internal */
+
+}  /* namespace future */
+
+#endif  /* FUTURE_CANCELLATION_H_ */
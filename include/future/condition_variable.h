@@ -26,17 +26,30 @@
 #include "future/mutex.h"
 
 #if defined(__linux__) || defined(__APPLE__)
+#  include <errno.h>
 #  include <pthread.h>
+#  include <time.h>
 #else
 #  error "Unsupported threading model on your system"
 #endif
 
+#include <stdint.h>
+
 namespace future {
 
 class condition_variable {
  public:
   condition_variable() {
+#if defined(__linux__)
+    /* Timed waits are not to be affected by wall clock adjustments. */
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&condition_, &attributes);
+    pthread_condattr_destroy(&attributes);
+#else
     pthread_cond_init(&condition_, NULL);
+#endif
   }
 
   ~condition_variable() {
@@ -44,7 +57,27 @@ class condition_variable {
   }
 
   void wait(mutex::scoped_lock& lock) {
+#ifdef FUTURE_MUTEX_PROFILING
+    lock.mutex_->profile_hold_end();
     pthread_cond_wait(&condition_, &lock.mutex_->mutex_);
+    lock.mutex_->profile_hold_begin();
+#else
+    pthread_cond_wait(&condition_, &lock.mutex_->mutex_);
+#endif
+  }
+
+  /* Returns false if timeout has expired. Spurious wake ups are possible
+   * same as with wait().
+   */
+  bool wait_for(mutex::scoped_lock& lock, uint64_t timeout_ms) {
+#ifdef FUTURE_MUTEX_PROFILING
+    lock.mutex_->profile_hold_end();
+    int result = timed_wait(&lock.mutex_->mutex_, timeout_ms);
+    lock.mutex_->profile_hold_begin();
+#else
+    int result = timed_wait(&lock.mutex_->mutex_, timeout_ms);
+#endif
+    return result != ETIMEDOUT;
   }
 
   void notify_one() {
@@ -56,6 +89,27 @@ class condition_variable {
   }
 
  protected:
+  /* Linux waits until a deadline on the monotonic clock the condition is
+   * initialized with, macOS only takes a relative timeout for that.
+   */
+  int timed_wait(pthread_mutex_t *mutex, uint64_t timeout_ms) {
+    struct timespec timeout;
+#if defined(__linux__)
+    clock_gettime(CLOCK_MONOTONIC, &timeout);
+    timeout.tv_sec += (time_t)(timeout_ms / 1000);
+    timeout.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (timeout.tv_nsec >= 1000000000L) {
+      timeout.tv_sec += 1;
+      timeout.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&condition_, mutex, &timeout);
+#else
+    timeout.tv_sec = (time_t)(timeout_ms / 1000);
+    timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    return pthread_cond_timedwait_relative_np(&condition_, mutex, &timeout);
+#endif
+  }
+
   pthread_cond_t condition_;
 };
 
@@ -0,0 +1,288 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_CPU_TOPOLOGY_H_
+#define FUTURE_CPU_TOPOLOGY_H_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "future/thread.h"
+
+namespace future {
+
+namespace internal {
+
+inline bool read_sysfs_string(const std::string& path, std::string *value) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (file == NULL) {
+    return false;
+  }
+  char buffer[256];
+  bool ok = fgets(buffer, sizeof(buffer), file) != NULL;
+  fclose(file);
+  if (!ok) {
+    return false;
+  }
+  *value = buffer;
+  while (!value->empty() && ((*value)[value->size() - 1] == '\n' ||
+                             (*value)[value->size() - 1] == ' ')) {
+    value->erase(value->size() - 1);
+  }
+  return true;
+}
+
+inline bool read_sysfs_int(const std::string& path, int *value) {
+  std::string string_value;
+  if (!read_sysfs_string(path, &string_value) || string_value.empty()) {
+    return false;
+  }
+  *value = atoi(string_value.c_str());
+  return true;
+}
+
+/* Sizes are given as "32K" or "8192K". */
+inline size_t parse_sysfs_size(const std::string& value) {
+  char *end;
+  size_t size = (size_t)strtoul(value.c_str(), &end, 10);
+  switch (*end) {
+    case 'K': return size * 1024;
+    case 'M': return size * 1024 * 1024;
+    case 'G': return size * 1024 * 1024 * 1024;
+  }
+  return size;
+}
+
+inline std::string int_to_string(int value) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%d", value);
+  return buffer;
+}
+
+}  /* namespace internal */
+
+/* CPU layout of the machine as reported by /sys/devices/system/cpu.
+ * On systems without sysfs every online CPU is reported as its own core
+ * with no cache information.
+ */
+class cpu_topology {
+ public:
+  struct cpu_info {
+    int cpu;
+    int core_id;
+    int package_id;
+    /* Hardware threads sharing the core with this CPU, including itself. */
+    cpu_set siblings;
+  };
+
+  struct cache_info {
+    int level;
+    /* "Data", "Instruction" or "Unified". */
+    std::string type;
+    size_t size;
+    size_t line_size;
+    cpu_set shared_cpus;
+  };
+
+  cpu_topology() {
+    detect();
+  }
+
+  int num_cpus() const {
+    return (int)cpus_.size();
+  }
+
+  /* Number of physical cores, hardware threads of a core are counted once. */
+  int num_cores() const {
+    std::vector<cpu_set> cores;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      bool found = false;
+      for (size_t j = 0; j < cores.size(); ++j) {
+        if (cores[j] == cpus_[i].siblings) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        cores.push_back(cpus_[i].siblings);
+      }
+    }
+    return (int)cores.size();
+  }
+
+  int num_packages() const {
+    std::vector<int> packages;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      if (std::find(packages.begin(), packages.end(),
+                    cpus_[i].package_id) == packages.end()) {
+        packages.push_back(cpus_[i].package_id);
+      }
+    }
+    return (int)packages.size();
+  }
+
+  const std::vector<cpu_info>& cpus() const {
+    return cpus_;
+  }
+
+  /* Every cache instance once, ordered by level. */
+  const std::vector<cache_info>& caches() const {
+    return caches_;
+  }
+
+  /* Returns NULL if the CPU is not online. */
+  const cpu_info *find_cpu(int cpu) const {
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      if (cpus_[i].cpu == cpu) {
+        return &cpus_[i];
+      }
+    }
+    return NULL;
+  }
+
+  /* CPUs sharing the given cache level with the given CPU. Empty set when
+   * there is no information about this cache level.
+   */
+  cpu_set cache_siblings(int cpu, int level) const {
+    for (size_t i = 0; i < caches_.size(); ++i) {
+      if (caches_[i].level == level &&
+          caches_[i].type != "Instruction" &&
+          caches_[i].shared_cpus.contains(cpu)) {
+        return caches_[i].shared_cpus;
+      }
+    }
+    return cpu_set();
+  }
+
+  /* One CPU per physical core, useful to avoid placing two busy threads
+   * on hardware threads of the same core.
+   */
+  cpu_set one_cpu_per_core() const {
+    cpu_set result;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      std::vector<int> siblings = cpus_[i].siblings.to_vector();
+      if (siblings.empty() || siblings[0] == cpus_[i].cpu) {
+        result.add(cpus_[i].cpu);
+      }
+    }
+    return result;
+  }
+
+  /* Process-wide topology, detected on first use. */
+  static const cpu_topology& system() {
+    static cpu_topology *topology = new cpu_topology();
+    return *topology;
+  }
+
+ protected:
+  void detect() {
+    const std::string root = "/sys/devices/system/cpu/";
+    std::string online;
+    cpu_set online_cpus;
+    if (internal::read_sysfs_string(root + "online", &online)) {
+      online_cpus = cpu_set::from_list(online);
+    } else {
+      for (int i = 0; i < thread::hardware_concurrency(); ++i) {
+        online_cpus.add(i);
+      }
+    }
+    std::vector<int> cpu_indices = online_cpus.to_vector();
+    for (size_t i = 0; i < cpu_indices.size(); ++i) {
+      int cpu = cpu_indices[i];
+      std::string cpu_root = root + "cpu" + internal::int_to_string(cpu) + "/";
+      cpu_info info;
+      info.cpu = cpu;
+      if (!internal::read_sysfs_int(cpu_root + "topology/core_id",
+                                    &info.core_id)) {
+        info.core_id = cpu;
+      }
+      if (!internal::read_sysfs_int(cpu_root + "topology/physical_package_id",
+                                    &info.package_id)) {
+        info.package_id = 0;
+      }
+      std::string siblings;
+      if (internal::read_sysfs_string(
+              cpu_root + "topology/thread_siblings_list", &siblings)) {
+        info.siblings = cpu_set::from_list(siblings);
+      } else {
+        info.siblings.add(cpu);
+      }
+      cpus_.push_back(info);
+      detect_caches(cpu_root + "cache/");
+    }
+    sort_caches();
+  }
+
+  void detect_caches(const std::string& cache_root) {
+    for (int index = 0;; ++index) {
+      std::string index_root =
+          cache_root + "index" + internal::int_to_string(index) + "/";
+      cache_info info;
+      std::string shared, size;
+      if (!internal::read_sysfs_int(index_root + "level", &info.level) ||
+          !internal::read_sysfs_string(index_root + "shared_cpu_list",
+                                       &shared)) {
+        break;
+      }
+      internal::read_sysfs_string(index_root + "type", &info.type);
+      internal::read_sysfs_string(index_root + "size", &size);
+      info.size = internal::parse_sysfs_size(size);
+      int line_size = 0;
+      internal::read_sysfs_int(index_root + "coherency_line_size", &line_size);
+      info.line_size = (size_t)line_size;
+      info.shared_cpus = cpu_set::from_list(shared);
+      bool found = false;
+      for (size_t i = 0; i < caches_.size(); ++i) {
+        if (caches_[i].level == info.level &&
+            caches_[i].type == info.type &&
+            caches_[i].shared_cpus == info.shared_cpus) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        caches_.push_back(info);
+      }
+    }
+  }
+
+  static bool cache_less(const cache_info& a, const cache_info& b) {
+    if (a.level != b.level) {
+      return a.level < b.level;
+    }
+    return a.shared_cpus.to_vector() < b.shared_cpus.to_vector();
+  }
+
+  void sort_caches() {
+    std::stable_sort(caches_.begin(), caches_.end(), cache_less);
+  }
+
+  std::vector<cpu_info> cpus_;
+  std::vector<cache_info> caches_;
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_CPU_TOPOLOGY_H_ */
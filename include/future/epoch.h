@@ -0,0 +1,333 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_EPOCH_H_
+#define FUTURE_EPOCH_H_
+
+#include <stdint.h>
+#include <cassert>
+#include <deque>
+
+#include "future/atomic.h"
+#include "future/mutex.h"
+#include "future/thread_specific.h"
+
+namespace future {
+
+class epoch;
+
+namespace internal {
+
+typedef void (*epoch_deleter)(void *pointer);
+
+template <typename T>
+void epoch_delete(void *pointer) {
+  delete static_cast<T*>(pointer);
+}
+
+struct epoch_retired {
+  void *pointer;
+  epoch_deleter deleter;
+  /* Global epoch at the moment of retirement. */
+  uint64_t epoch;
+};
+
+/* Per-thread state of a domain. Records are never freed while the domain
+ * is alive, records of exited threads are reused by new threads.
+ */
+struct epoch_record {
+  explicit epoch_record(::future::epoch *domain)
+      : domain(domain),
+        state(0),
+        in_use(1),
+        nesting(0),
+        next(NULL) {}
+
+  ::future::epoch *domain;
+  /* Observed epoch shifted left by one, lowest bit is set while the thread
+   * is inside a critical section.
+   */
+  atomic<uint64_t> state;
+  atomic<int> in_use;
+  int nesting;
+  std::deque<epoch_retired> retired;
+  epoch_record *next;
+};
+
+inline void epoch_record_release(epoch_record *record);
+
+}  /* namespace internal */
+
+/* Epoch based memory reclamation domain.
+ *
+ * Readers of a lock-free structure wrap every access in a guard, writers
+ * retire unlinked nodes instead of deleting them. A retired node is freed
+ * once the global epoch moved two steps past the epoch it was retired in,
+ * which can only happen after every thread that could have seen the node
+ * left its critical section.
+ *
+ * Entering and leaving a critical section only touches the record of the
+ * calling thread. Retired nodes are buffered in a per-thread list, every
+ * retire_batch_size retirements the thread frees what is safe already and
+ * hands the rest over to a domain-wide list. That list is freed by
+ * collect() from any thread, so a background thread can reclaim garbage
+ * of live workers. At most retire_batch_size nodes per thread stay
+ * buffered until the thread retires more, calls collect() or exits.
+ *
+ * Domain is to outlive all the threads which used it, or use the process
+ * wide default_domain() which is never destroyed.
+ */
+class epoch {
+ public:
+  typedef internal::epoch_deleter deleter_type;
+
+  /* Critical section, nodes read inside of it are not freed until it ends. */
+  class guard {
+   public:
+    explicit guard(epoch& domain) : domain_(domain) {
+      domain_.enter();
+    }
+
+    ~guard() {
+      domain_.exit();
+    }
+
+   protected:
+    epoch& domain_;
+
+   private:
+    guard(const guard& other);
+    void operator=(const guard& other);
+  };
+
+  epoch()
+      : global_epoch_(0),
+        records_(NULL),
+        num_shared_(0),
+        shared_mutex_("epoch_shared_retired"),
+        record_(internal::epoch_record_release) {}
+
+  /* No thread is to be inside a critical section of the domain. */
+  ~epoch() {
+    /* Records are freed here, not by the thread exit cleanup. */
+    record_.release();
+    internal::epoch_record *record = records_.load();
+    while (record != NULL) {
+      internal::epoch_record *next = record->next;
+      free_retired(&record->retired, ~(uint64_t)0);
+      delete record;
+      record = next;
+    }
+    free_retired(&shared_, ~(uint64_t)0);
+  }
+
+  /* Critical sections can be nested. */
+  void enter() {
+    internal::epoch_record *record = current_record();
+    if (record->nesting++ == 0) {
+      uint64_t global_epoch =
+          global_epoch_.load(internal::memory_order_relaxed);
+      record->state.store((global_epoch << 1) | 1,
+                          internal::memory_order_relaxed);
+      /* Announcement is to be visible before any shared pointer is read. */
+      internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    }
+  }
+
+  void exit() {
+    internal::epoch_record *record = current_record();
+    assert(record->nesting > 0);
+    if (--record->nesting == 0) {
+      record->state.store(record->state.load(internal::memory_order_relaxed) &
+                              ~(uint64_t)1,
+                          internal::memory_order_release);
+    }
+  }
+
+  /* Node is to be unlinked already, so new readers can't reach it. */
+  void retire(void *pointer, deleter_type deleter) {
+    internal::epoch_record *record = current_record();
+    internal::epoch_retired retired;
+    retired.pointer = pointer;
+    retired.deleter = deleter;
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    retired.epoch = global_epoch_.load(internal::memory_order_relaxed);
+    record->retired.push_back(retired);
+    if (record->retired.size() >= retire_batch_size) {
+      collect();
+      if (!record->retired.empty()) {
+        add_shared(&record->retired);
+      }
+    }
+  }
+
+  template <typename T>
+  void retire(T *pointer) {
+    retire(pointer, internal::epoch_delete<T>);
+  }
+
+  /* Tries to advance the epoch and frees nodes which are safe to free from
+   * the list of the calling thread and from the domain-wide list. Is cheap
+   * enough to be called periodically from a background thread or timer.
+   */
+  void collect() {
+    try_advance();
+    uint64_t safe_epoch = global_epoch_.load(internal::memory_order_acquire);
+    if (safe_epoch < 2) {
+      return;
+    }
+    safe_epoch -= 2;
+    free_retired(&current_record()->retired, safe_epoch);
+    if (num_shared_.load(internal::memory_order_relaxed) != 0) {
+      std::deque<internal::epoch_retired> shared;
+      {
+        mutex::scoped_lock lock(shared_mutex_);
+        shared.swap(shared_);
+        num_shared_.store(0, internal::memory_order_relaxed);
+      }
+      free_retired(&shared, safe_epoch);
+      if (!shared.empty()) {
+        add_shared(&shared);
+      }
+    }
+  }
+
+  uint64_t current_epoch() const {
+    return global_epoch_.load(internal::memory_order_relaxed);
+  }
+
+  /* Domain which is never destroyed, usable from any thread at any time. */
+  static epoch& default_domain() {
+    static epoch *domain = new epoch();
+    return *domain;
+  }
+
+ protected:
+  friend void internal::epoch_record_release(internal::epoch_record *record);
+
+  enum { retire_batch_size = 64 };
+
+  internal::epoch_record *current_record() {
+    internal::epoch_record *record = record_.get();
+    if (record == NULL) {
+      record = acquire_record();
+      record_.reset(record);
+    }
+    return record;
+  }
+
+  internal::epoch_record *acquire_record() {
+    for (internal::epoch_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      int in_use = 0;
+      if (record->in_use.load(internal::memory_order_relaxed) == 0 &&
+          record->in_use.compare_exchange_strong(in_use, 1)) {
+        return record;
+      }
+    }
+    internal::epoch_record *record = new internal::epoch_record(this);
+    internal::epoch_record *head = records_.load();
+    do {
+      record->next = head;
+    } while (!records_.compare_exchange_weak(head, record));
+    return record;
+  }
+
+  /* Called when the thread exits, nodes it did not free yet are given to
+   * the domain.
+   */
+  void release_record(internal::epoch_record *record) {
+    assert(record->nesting == 0);
+    if (!record->retired.empty()) {
+      add_shared(&record->retired);
+    }
+    record->in_use.store(0, internal::memory_order_release);
+  }
+
+  void add_shared(std::deque<internal::epoch_retired> *retired) {
+    mutex::scoped_lock lock(shared_mutex_);
+    shared_.insert(shared_.end(), retired->begin(), retired->end());
+    retired->clear();
+    num_shared_.store((int)shared_.size(), internal::memory_order_relaxed);
+  }
+
+  /* Epoch can only advance once every thread inside a critical section
+   * has observed the current one.
+   */
+  void try_advance() {
+    uint64_t global_epoch = global_epoch_.load();
+    for (internal::epoch_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      uint64_t state = record->state.load();
+      if ((state & 1) != 0 && (state >> 1) != global_epoch) {
+        return;
+      }
+    }
+    global_epoch_.compare_exchange_strong(global_epoch, global_epoch + 1);
+  }
+
+  /* Lists merged from different threads are not ordered by epoch, so the
+   * whole list is scanned.
+   */
+  static void free_retired(std::deque<internal::epoch_retired> *retired,
+                           uint64_t safe_epoch) {
+    size_t num_kept = 0;
+    for (size_t i = 0; i < retired->size(); ++i) {
+      internal::epoch_retired current = (*retired)[i];
+      if (current.epoch <= safe_epoch) {
+        current.deleter(current.pointer);
+      } else {
+        (*retired)[num_kept++] = current;
+      }
+    }
+    retired->resize(num_kept);
+  }
+
+  internal::atomic<uint64_t> global_epoch_;
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<internal::epoch_record*> records_;
+
+  /* Retired nodes handed over by live and exited threads. */
+  internal::atomic<int> num_shared_;
+  mutex shared_mutex_;
+  std::deque<internal::epoch_retired> shared_;
+
+  thread_specific_ptr<internal::epoch_record> record_;
+
+ private:
+  epoch(const epoch& other);
+  void operator=(const epoch& other);
+};
+
+namespace internal {
+
+inline void epoch_record_release(epoch_record *record) {
+  record->domain->release_record(record);
+}
+
+}  /* namespace internal */
+
+}  /* namespace future */
+
+#endif  /* FUTURE_EPOCH_H_ */
@@ -0,0 +1,83 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_EXECUTOR_H_
+#define FUTURE_EXECUTOR_H_
+
+#include "future/bind.h"
+#include "future/cancellation.h"
+#include "future/function.h"
+
+namespace future {
+
+namespace internal {
+
+inline void run_unless_cancelled(function::function<void(void)> task,
+                                 cancellation_token token) {
+  if (!token.is_cancelled()) {
+    task();
+  }
+}
+
+}  /* namespace internal */
+
+/* Interface of everything which is able to run tasks: thread pools,
+ * inline executors and so on.
+ */
+class executor {
+ public:
+  typedef function::function<void(void)> task_type;
+
+  virtual ~executor() {}
+
+  virtual void submit(task_type task) = 0;
+
+  /* Task is dropped if the token gets cancelled before the task starts,
+   * running task is to poll the token itself.
+   */
+  void submit(task_type task, const cancellation_token& token) {
+    if (token.is_cancelled()) {
+      return;
+    }
+    if (!token.can_be_cancelled()) {
+      submit(task);
+      return;
+    }
+    submit(::future::bind::function_bind(internal::run_unless_cancelled,
+                                         task,
+                                         token));
+  }
+};
+
+/* Runs tasks immediately in the thread which submits them. */
+class inline_executor : public executor {
+ public:
+  using executor::submit;
+
+  void submit(task_type task) {
+    task();
+  }
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_EXECUTOR_H_ */
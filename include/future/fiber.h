@@ -0,0 +1,602 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_FIBER_H_
+#define FUTURE_FIBER_H_
+
+#if defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <stdint.h>
+#  include <sys/mman.h>
+#  include <ucontext.h>
+#  include <unistd.h>
+#else
+#  error "Fibers are not supported on your system"
+#endif
+
+#include <cassert>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/executor.h"
+#include "future/function.h"
+#include "future/futex.h"
+#include "future/thread_pool.h"
+
+namespace future {
+
+namespace internal {
+
+/* Lock for the short critical sections of fiber primitives. It's also
+ * released by the thread which switched away from the fiber, so it can't
+ * be an OS mutex.
+ */
+class spin_lock {
+ public:
+  spin_lock() : locked_(0) {}
+
+  void lock() {
+    while (locked_.exchange(1, memory_order_acquire) != 0) {
+      while (locked_.load(memory_order_relaxed) != 0) {
+        cpu_relax();
+      }
+    }
+  }
+
+  void unlock() {
+    locked_.store(0, memory_order_release);
+  }
+
+ protected:
+  atomic<int> locked_;
+
+ private:
+  spin_lock(const spin_lock& other);
+  void operator=(const spin_lock& other);
+};
+
+/* Fiber stacks are mapped with an inaccessible guard page below them, so
+ * overflow crashes instead of silently corrupting memory. Stacks of the
+ * default size are kept for reuse.
+ */
+
+struct fiber_stack {
+  /* Beginning of the mapping, which is the guard page. */
+  char *memory;
+  size_t size;
+};
+
+enum {
+  fiber_default_stack_size = 128 * 1024,
+  fiber_max_pooled_stacks = 1024
+};
+
+inline size_t fiber_page_size() {
+  static size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+inline pthread_mutex_t *fiber_stack_pool_mutex() {
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  return &mutex;
+}
+
+inline std::vector<char*> *&fiber_stack_pool() {
+  static std::vector<char*> *pool = NULL;
+  return pool;
+}
+
+inline fiber_stack fiber_stack_allocate(size_t stack_size) {
+  size_t page_size = fiber_page_size();
+  fiber_stack stack;
+  stack.size = (stack_size + page_size - 1) / page_size * page_size +
+               page_size;
+  stack.memory = NULL;
+  if (stack_size == fiber_default_stack_size) {
+    pthread_mutex_lock(fiber_stack_pool_mutex());
+    std::vector<char*> *pool = fiber_stack_pool();
+    if (pool != NULL && !pool->empty()) {
+      stack.memory = pool->back();
+      pool->pop_back();
+    }
+    pthread_mutex_unlock(fiber_stack_pool_mutex());
+    if (stack.memory != NULL) {
+      return stack;
+    }
+  }
+  void *memory = mmap(NULL, stack.size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(memory != MAP_FAILED);
+  mprotect(memory, page_size, PROT_NONE);
+  stack.memory = reinterpret_cast<char*>(memory);
+  return stack;
+}
+
+inline void fiber_stack_release(const fiber_stack& stack) {
+  size_t page_size = fiber_page_size();
+  if (stack.size == fiber_default_stack_size + page_size) {
+    pthread_mutex_lock(fiber_stack_pool_mutex());
+    std::vector<char*> *&pool = fiber_stack_pool();
+    if (pool == NULL) {
+      pool = new std::vector<char*>();
+    }
+    bool pooled = false;
+    if (pool->size() < fiber_max_pooled_stacks) {
+      pool->push_back(stack.memory);
+      pooled = true;
+    }
+    pthread_mutex_unlock(fiber_stack_pool_mutex());
+    if (pooled) {
+      return;
+    }
+  }
+  munmap(stack.memory, stack.size);
+}
+
+struct fiber_state;
+
+/* Fibers migrate between threads, so the current fiber is never cached
+ * across a context switch, hence the accessors are not inlined.
+ */
+__attribute__((noinline)) inline fiber_state *&fiber_current_slot() {
+  static __thread fiber_state *current = NULL;
+  return current;
+}
+
+__attribute__((noinline)) inline fiber_state *fiber_current() {
+  return fiber_current_slot();
+}
+
+/* What the thread which resumed the fiber is to do once the fiber
+ * switched away.
+ */
+enum fiber_switch_action {
+  fiber_switch_reschedule,
+  fiber_switch_unlock,
+  fiber_switch_finish
+};
+
+struct fiber_waiter;
+
+struct fiber_state {
+  explicit fiber_state(function::function<void(void)> function,
+                       executor *target)
+      : caller(NULL),
+        function(function),
+        target(target),
+        refcount(2),
+        finished(false),
+        joiners(NULL),
+        switch_action(fiber_switch_reschedule),
+        switch_lock(NULL) {}
+
+  ucontext_t context;
+  ucontext_t *caller;
+  fiber_stack stack;
+  function::function<void(void)> function;
+  executor *target;
+  /* Owned by the fiber handle and by the running fiber itself. */
+  atomic<int> refcount;
+
+  spin_lock join_lock;
+  bool finished;
+  fiber_waiter *joiners;
+
+  fiber_switch_action switch_action;
+  spin_lock *switch_lock;
+};
+
+inline void fiber_release(fiber_state *fiber) {
+  if (fiber->refcount.fetch_sub(1, memory_order_acq_rel) == 1) {
+    delete fiber;
+  }
+}
+
+inline void fiber_resume(fiber_state *fiber);
+
+inline void fiber_schedule(fiber_state *fiber) {
+  fiber->target->submit(::future::bind::function_bind(fiber_resume, fiber));
+}
+
+/* Switch from the fiber back to the thread which resumed it. */
+inline void fiber_switch_out(fiber_state *fiber,
+                             fiber_switch_action action,
+                             spin_lock *lock) {
+  fiber->switch_action = action;
+  fiber->switch_lock = lock;
+  swapcontext(&fiber->context, fiber->caller);
+}
+
+/* Suspends the current fiber, the lock is released once the fiber is
+ * switched away, so whoever wakes it up under the lock can't resume it
+ * too early.
+ */
+inline void fiber_suspend(spin_lock *lock) {
+  fiber_state *fiber = fiber_current();
+  assert(fiber != NULL);
+  fiber_switch_out(fiber, fiber_switch_unlock, lock);
+}
+
+/* Waiter for fiber primitives, lives on the stack of the waiting fiber or
+ * thread. Fibers are suspended, threads sleep on a futex.
+ */
+struct fiber_waiter {
+  fiber_waiter()
+      : next(NULL),
+        fiber(fiber_current()),
+        signalled(0) {}
+
+  /* Called with the lock held, returns once woken up with the lock
+   * released.
+   */
+  void wait(spin_lock *lock) {
+    if (fiber != NULL) {
+      fiber_suspend(lock);
+      return;
+    }
+    lock->unlock();
+    while (signalled.load(memory_order_acquire) == 0) {
+      futex_wait(signalled.address(), 0);
+    }
+  }
+
+  /* Called without the lock, waiter is not accessed once it's woken up. */
+  void wake() {
+    fiber_state *waiting_fiber = fiber;
+    if (waiting_fiber != NULL) {
+      fiber_schedule(waiting_fiber);
+    } else {
+      signalled.store(1, memory_order_release);
+      futex_wake(signalled.address(), 1);
+    }
+  }
+
+  fiber_waiter *next;
+  fiber_state *fiber;
+  atomic<int> signalled;
+};
+
+class fiber_wait_queue {
+ public:
+  fiber_wait_queue() : head_(NULL), tail_(NULL) {}
+
+  bool empty() const {
+    return head_ == NULL;
+  }
+
+  void push(fiber_waiter *waiter) {
+    waiter->next = NULL;
+    if (tail_ != NULL) {
+      tail_->next = waiter;
+    } else {
+      head_ = waiter;
+    }
+    tail_ = waiter;
+  }
+
+  fiber_waiter *pop() {
+    fiber_waiter *waiter = head_;
+    if (waiter != NULL) {
+      head_ = waiter->next;
+      if (head_ == NULL) {
+        tail_ = NULL;
+      }
+    }
+    return waiter;
+  }
+
+  /* Takes all the waiters, to be woken up outside of the lock. */
+  fiber_waiter *pop_all() {
+    fiber_waiter *waiters = head_;
+    head_ = tail_ = NULL;
+    return waiters;
+  }
+
+  static void wake_all(fiber_waiter *waiters) {
+    while (waiters != NULL) {
+      fiber_waiter *next = waiters->next;
+      waiters->wake();
+      waiters = next;
+    }
+  }
+
+ protected:
+  fiber_waiter *head_;
+  fiber_waiter *tail_;
+};
+
+inline void fiber_finish(fiber_state *fiber) {
+  fiber_stack_release(fiber->stack);
+  fiber->join_lock.lock();
+  fiber->finished = true;
+  fiber_waiter *joiners = fiber->joiners;
+  fiber->joiners = NULL;
+  fiber->join_lock.unlock();
+  fiber_wait_queue::wake_all(joiners);
+  fiber_release(fiber);
+}
+
+/* Entry point of the fiber, pointer is split into two ints as required
+ * by makecontext().
+ */
+inline void fiber_entry(unsigned int high, unsigned int low) {
+  uintptr_t address = ((uintptr_t)high << 16 << 16) | (uintptr_t)low;
+  fiber_state *fiber = reinterpret_cast<fiber_state*>(address);
+  fiber->function();
+  /* Free resources bound to the function as early as possible. */
+  fiber->function = function::function<void(void)>();
+  fiber_switch_out(fiber, fiber_switch_finish, NULL);
+}
+
+inline void fiber_start(fiber_state *fiber, size_t stack_size) {
+  fiber->stack = fiber_stack_allocate(stack_size);
+  size_t page_size = fiber_page_size();
+  getcontext(&fiber->context);
+  fiber->context.uc_stack.ss_sp = fiber->stack.memory + page_size;
+  fiber->context.uc_stack.ss_size = fiber->stack.size - page_size;
+  fiber->context.uc_link = NULL;
+  uintptr_t address = reinterpret_cast<uintptr_t>(fiber);
+  makecontext(&fiber->context,
+              reinterpret_cast<void (*)()>(fiber_entry),
+              2,
+              (unsigned int)(address >> 16 >> 16),
+              (unsigned int)(address & 0xffffffff));
+  fiber_schedule(fiber);
+}
+
+/* Runs the fiber on the calling thread until it switches away. */
+inline void fiber_resume(fiber_state *fiber) {
+  ucontext_t caller;
+  fiber->caller = &caller;
+  fiber_current_slot() = fiber;
+  swapcontext(&caller, &fiber->context);
+  fiber_current_slot() = NULL;
+  switch (fiber->switch_action) {
+    case fiber_switch_reschedule:
+      fiber_schedule(fiber);
+      break;
+    case fiber_switch_unlock:
+      /* Fiber might be resumed by another thread right after this. */
+      fiber->switch_lock->unlock();
+      break;
+    case fiber_switch_finish:
+      fiber_finish(fiber);
+      break;
+  }
+}
+
+}  /* namespace internal */
+
+/* Cooperatively scheduled user-space thread with its own stack.
+ *
+ * Fibers are resumed as tasks of the given executor (the default thread
+ * pool if not specified) and run until they yield, block on one of the
+ * fiber primitives or finish, so thousands of mostly waiting fibers share
+ * a few OS threads.
+ *
+ * Fiber is to be either joined or detached before the handle is destroyed.
+ * Joining from a fiber suspends it, joining from a pool task blocks the
+ * worker thread.
+ */
+class fiber {
+ public:
+  typedef function::function<void(void)> function_type;
+
+  /* Zero stack size means the default one, stacks of which are reused. */
+  explicit fiber(function_type function,
+                 executor *target = NULL,
+                 size_t stack_size = 0) {
+    if (target == NULL) {
+      target = &thread_pool::default_pool();
+    }
+    if (stack_size == 0) {
+      stack_size = internal::fiber_default_stack_size;
+    }
+    state_ = new internal::fiber_state(function, target);
+    internal::fiber_start(state_, stack_size);
+  }
+
+  ~fiber() {
+    assert(state_ == NULL);
+  }
+
+  bool joinable() const {
+    return state_ != NULL;
+  }
+
+  void join() {
+    assert(joinable());
+    state_->join_lock.lock();
+    if (state_->finished) {
+      state_->join_lock.unlock();
+    } else {
+      internal::fiber_waiter waiter;
+      waiter.next = state_->joiners;
+      state_->joiners = &waiter;
+      waiter.wait(&state_->join_lock);
+    }
+    internal::fiber_release(state_);
+    state_ = NULL;
+  }
+
+  void detach() {
+    assert(joinable());
+    internal::fiber_release(state_);
+    state_ = NULL;
+  }
+
+  /* Lets other fibers run, outside of fibers yields the OS thread. */
+  static void yield() {
+    internal::fiber_state *current = internal::fiber_current();
+    if (current == NULL) {
+      sched_yield();
+      return;
+    }
+    internal::fiber_switch_out(current,
+                               internal::fiber_switch_reschedule,
+                               NULL);
+  }
+
+  static bool in_fiber() {
+    return internal::fiber_current() != NULL;
+  }
+
+ protected:
+  internal::fiber_state *state_;
+
+ private:
+  fiber(const fiber& other);
+  void operator=(const fiber& other);
+};
+
+class fiber_condition_variable;
+
+/* Mutex which suspends the waiting fiber instead of blocking the thread.
+ * Also works from plain threads, which sleep on a futex. Ownership is
+ * handed over to the first waiter directly on unlock.
+ */
+class fiber_mutex {
+ public:
+  class scoped_lock {
+   public:
+    explicit scoped_lock(fiber_mutex& mutex)
+        : mutex_(mutex),
+          locked_(true) {
+      mutex_.lock();
+    }
+
+    ~scoped_lock() {
+      if (locked_) {
+        mutex_.unlock();
+      }
+    }
+
+    void lock() {
+      assert(!locked_);
+      mutex_.lock();
+      locked_ = true;
+    }
+
+    void unlock() {
+      assert(locked_);
+      mutex_.unlock();
+      locked_ = false;
+    }
+
+   protected:
+    friend class fiber_condition_variable;
+    fiber_mutex& mutex_;
+    bool locked_;
+
+   private:
+    scoped_lock(const scoped_lock& other);
+    void operator=(const scoped_lock& other);
+  };
+
+  fiber_mutex() : locked_(false) {}
+
+  void lock() {
+    lock_.lock();
+    if (!locked_) {
+      locked_ = true;
+      lock_.unlock();
+      return;
+    }
+    internal::fiber_waiter waiter;
+    waiters_.push(&waiter);
+    waiter.wait(&lock_);
+  }
+
+  bool try_lock() {
+    lock_.lock();
+    bool acquired = !locked_;
+    locked_ = true;
+    lock_.unlock();
+    return acquired;
+  }
+
+  void unlock() {
+    lock_.lock();
+    internal::fiber_waiter *waiter = waiters_.pop();
+    if (waiter == NULL) {
+      locked_ = false;
+    }
+    lock_.unlock();
+    if (waiter != NULL) {
+      waiter->wake();
+    }
+  }
+
+ protected:
+  internal::spin_lock lock_;
+  bool locked_;
+  internal::fiber_wait_queue waiters_;
+
+ private:
+  fiber_mutex(const fiber_mutex& other);
+  void operator=(const fiber_mutex& other);
+};
+
+/* Condition variable for fiber_mutex. */
+class fiber_condition_variable {
+ public:
+  fiber_condition_variable() {}
+
+  void wait(fiber_mutex::scoped_lock& lock) {
+    internal::fiber_waiter waiter;
+    lock_.lock();
+    waiters_.push(&waiter);
+    lock.mutex_.unlock();
+    waiter.wait(&lock_);
+    lock.mutex_.lock();
+  }
+
+  void notify_one() {
+    lock_.lock();
+    internal::fiber_waiter *waiter = waiters_.pop();
+    lock_.unlock();
+    if (waiter != NULL) {
+      waiter->wake();
+    }
+  }
+
+  void notify_all() {
+    lock_.lock();
+    internal::fiber_waiter *waiters = waiters_.pop_all();
+    lock_.unlock();
+    internal::fiber_wait_queue::wake_all(waiters);
+  }
+
+ protected:
+  internal::spin_lock lock_;
+  internal::fiber_wait_queue waiters_;
+
+ private:
+  fiber_condition_variable(const fiber_condition_variable& other);
+  void operator=(const fiber_condition_variable& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_FIBER_H_ */
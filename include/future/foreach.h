@@ -90,7 +90,7 @@ class foreach_helper<T, true> {
 #if defined(__GNUC__) || defined(__clang__)
 #  define FUTURE_FOREACH(var, range) \
   if (bool global_stop = false) {} else \
-  for (future::internal::foreach_helper<__typeof__(range), \
+  for (::future::internal::foreach_helper<__typeof__(range), \
                                         !FUTURE_IS_LVALUE(range)> \
           helper(range, false); \
        !helper.is_done() && !global_stop; \
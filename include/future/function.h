@@ -157,7 +157,7 @@ namespace internal {
 template<typename R>
 class function_base {
   typedef ::future::internal::function_bind_base<R> bind_type;
-  typedef future::internal::argument_list argument_list_type;
+  typedef ::future::internal::argument_list argument_list_type;
 
  public:
   function_base() : function_bind_(NULL) {}
@@ -195,8 +195,8 @@ class function_base {
   }
 
 #define FUNCTION_INVOKE_COMMON_PRE() \
-    using future::internal::argument_wrapper; \
-    using future::internal::argument_wrapper_base; \
+    using ::future::internal::argument_wrapper; \
+    using ::future::internal::argument_wrapper_base; \
     assert_invoke()
 
 #define FUNCTION_INVOKE_COMMON_POST(arguments, num_arguments) \
@@ -0,0 +1,163 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_FUTEX_H_
+#define FUTURE_FUTEX_H_
+
+#if defined(__linux__)
+#  include <errno.h>
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+#  include <unistd.h>
+#elif defined(__APPLE__)
+#  include <pthread.h>
+#  include <sys/time.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <stdint.h>
+#include <climits>
+
+namespace future {
+namespace internal {
+
+/* Wait/wake on a 32bit word. futex_wait() blocks for as long as the word
+ * is equal to the expected value, and spurious wake ups are possible, so
+ * callers are to re-check their condition in a loop.
+ *
+ * On Linux this is a thin wrapper around futex syscall, elsewhere waiters
+ * are parked on a hashed table of condition variables.
+ */
+
+#if defined(__linux__)
+
+inline bool futex_wait_impl(int *address,
+                            int expected,
+                            const struct timespec *timeout) {
+  int result = syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE,
+                       expected, timeout, NULL, 0);
+  return !(result == -1 && errno == ETIMEDOUT);
+}
+
+inline void futex_wait(int *address, int expected) {
+  futex_wait_impl(address, expected, NULL);
+}
+
+/* Returns false if the timeout has expired. */
+inline bool futex_wait_for(int *address, int expected, uint64_t timeout_ns) {
+  struct timespec timeout;
+  timeout.tv_sec = (time_t)(timeout_ns / 1000000000ULL);
+  timeout.tv_nsec = (long)(timeout_ns % 1000000000ULL);
+  return futex_wait_impl(address, expected, &timeout);
+}
+
+inline void futex_wake(int *address, int count) {
+  syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#else
+
+struct futex_bucket {
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;
+};
+
+enum { num_futex_buckets = 64 };
+
+inline futex_bucket *futex_buckets() {
+  static futex_bucket buckets[num_futex_buckets];
+  return buckets;
+}
+
+inline void futex_buckets_init() {
+  futex_bucket *buckets = futex_buckets();
+  for (int i = 0; i < num_futex_buckets; ++i) {
+    pthread_mutex_init(&buckets[i].mutex, NULL);
+    pthread_cond_init(&buckets[i].condition, NULL);
+  }
+}
+
+inline futex_bucket *futex_bucket_for(int *address) {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, futex_buckets_init);
+  uintptr_t hash = (uintptr_t)address;
+  hash = (hash >> 4) ^ (hash >> 12);
+  return &futex_buckets()[hash % num_futex_buckets];
+}
+
+inline bool futex_wait_impl(int *address,
+                            int expected,
+                            const struct timespec *deadline) {
+  futex_bucket *bucket = futex_bucket_for(address);
+  bool result = true;
+  pthread_mutex_lock(&bucket->mutex);
+  if (__atomic_load_n(address, __ATOMIC_SEQ_CST) == expected) {
+    if (deadline == NULL) {
+      pthread_cond_wait(&bucket->condition, &bucket->mutex);
+    } else {
+      result = pthread_cond_timedwait(&bucket->condition,
+                                      &bucket->mutex,
+                                      deadline) == 0;
+    }
+  }
+  pthread_mutex_unlock(&bucket->mutex);
+  return result;
+}
+
+inline void futex_wait(int *address, int expected) {
+  futex_wait_impl(address, expected, NULL);
+}
+
+inline bool futex_wait_for(int *address, int expected, uint64_t timeout_ns) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  uint64_t deadline_ns = (uint64_t)now.tv_sec * 1000000000ULL +
+                         (uint64_t)now.tv_usec * 1000ULL +
+                         timeout_ns;
+  struct timespec deadline;
+  deadline.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+  deadline.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+  return futex_wait_impl(address, expected, &deadline);
+}
+
+/* Buckets are shared by different addresses, so all the waiters are woken
+ * up and the ones which are not interested go back to sleep.
+ */
+inline void futex_wake(int *address, int /*count*/) {
+  futex_bucket *bucket = futex_bucket_for(address);
+  pthread_mutex_lock(&bucket->mutex);
+  pthread_cond_broadcast(&bucket->condition);
+  pthread_mutex_unlock(&bucket->mutex);
+}
+
+#endif
+
+inline void futex_wake_all(int *address) {
+  futex_wake(address, INT_MAX);
+}
+
+}  /* namespace internal */
+}  /* namespace future */
+
+#endif  /* FUTURE_FUTEX_H_ */
@@ -0,0 +1,852 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_FUTURE_H_
+#define FUTURE_FUTURE_H_
+
+#include <stdint.h>
+#include <cassert>
+#include <iterator>
+#include <new>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/cancellation.h"
+#include "future/clock.h"
+#include "future/executor.h"
+#include "future/function.h"
+#include "future/futex.h"
+
+namespace future {
+
+template <typename T> class future;
+template <typename T> class promise;
+
+namespace internal {
+
+struct future_access;
+
+/* Callback which is invoked once shared state becomes ready. */
+class future_continuation {
+ public:
+  future_continuation() : next(NULL) {}
+
+  virtual ~future_continuation() {}
+
+  /* Called exactly once, takes care of freeing the continuation. */
+  virtual void run() = 0;
+
+  future_continuation *next;
+};
+
+/* Part of the shared state which doesn't depend on the value type:
+ * readiness, waiting, reference counting and continuations.
+ *
+ * Nothing here takes a lock: waiters sleep on the status word and
+ * continuations are kept in a lock-free stack which is closed once the
+ * value is set.
+ */
+class future_shared_state_base {
+ public:
+  future_shared_state_base()
+      : status_(status_pending),
+        num_references_(1),
+        continuations_(NULL),
+        cancelled_(false),
+        broken_(false) {}
+
+  virtual ~future_shared_state_base() {}
+
+  inline void add_reference() {
+    num_references_.fetch_add(1, memory_order_relaxed);
+  }
+
+  inline void release() {
+    if (num_references_.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  inline bool is_ready() const {
+    return status_.load(memory_order_acquire) == status_ready;
+  }
+
+  /* Cancelled state is ready, but has no value. */
+  inline bool is_cancelled() const {
+    return is_ready() && cancelled_;
+  }
+
+  /* Broken state is ready without a value because the promise was
+   * destroyed before setting it.
+   */
+  inline bool is_broken() const {
+    return is_ready() && broken_;
+  }
+
+  inline bool has_value() const {
+    return is_ready() && !cancelled_ && !broken_;
+  }
+
+  void mark_cancelled() {
+    cancelled_ = true;
+    mark_ready();
+  }
+
+  void mark_broken() {
+    broken_ = true;
+    mark_ready();
+  }
+
+  /* Makes this state ready without a value the same way as the source,
+   * which is ready and has no value.
+   */
+  void propagate_no_value(const future_shared_state_base *source) {
+    assert(source->is_ready() && !source->has_value());
+    if (source->broken_) {
+      mark_broken();
+    } else {
+      mark_cancelled();
+    }
+  }
+
+  void wait() {
+    for (;;) {
+      int status = status_.load(memory_order_acquire);
+      if (status == status_ready) {
+        return;
+      }
+      if (status == status_pending &&
+          !status_.compare_exchange_strong(status, status_has_waiters,
+                                           memory_order_acq_rel)) {
+        continue;
+      }
+      futex_wait(status_.address(), status_has_waiters);
+    }
+  }
+
+  /* Returns false if the value did not become ready in time. */
+  bool wait_for(uint64_t timeout_ms) {
+    uint64_t deadline = monotonic_time_ns() + timeout_ms * 1000000ULL;
+    for (;;) {
+      int status = status_.load(memory_order_acquire);
+      if (status == status_ready) {
+        return true;
+      }
+      uint64_t now = monotonic_time_ns();
+      if (now >= deadline) {
+        return false;
+      }
+      if (status == status_pending &&
+          !status_.compare_exchange_strong(status, status_has_waiters,
+                                           memory_order_acq_rel)) {
+        continue;
+      }
+      futex_wait_for(status_.address(), status_has_waiters, deadline - now);
+    }
+  }
+
+  /* Runs continuation immediately if the state is ready already, otherwise
+   * it'll be run by the thread which sets the value.
+   */
+  void add_continuation(future_continuation *continuation) {
+    future_continuation *head = continuations_.load(memory_order_acquire);
+    do {
+      if (head == continuations_closed()) {
+        continuation->run();
+        return;
+      }
+      continuation->next = head;
+    } while (!continuations_.compare_exchange_weak(head, continuation,
+                                                   memory_order_acq_rel));
+  }
+
+ protected:
+  enum {
+    status_pending = 0,
+    status_has_waiters = 1,
+    status_ready = 2
+  };
+
+  static future_continuation *continuations_closed() {
+    static char marker;
+    return reinterpret_cast<future_continuation*>(&marker);
+  }
+
+  /* To be called once the value is stored. */
+  void mark_ready() {
+    int previous_status = status_.exchange(status_ready,
+                                           memory_order_acq_rel);
+    assert(previous_status != status_ready);
+    if (previous_status == status_has_waiters) {
+      futex_wake_all(status_.address());
+    }
+    future_continuation *head =
+        continuations_.exchange(continuations_closed(), memory_order_acq_rel);
+    /* Stack has continuations in reverse order, run them in the order they
+     * were added.
+     */
+    future_continuation *reversed = NULL;
+    while (head != NULL) {
+      future_continuation *next = head->next;
+      head->next = reversed;
+      reversed = head;
+      head = next;
+    }
+    while (reversed != NULL) {
+      future_continuation *next = reversed->next;
+      reversed->run();
+      reversed = next;
+    }
+  }
+
+  atomic<int> status_;
+  atomic<int> num_references_;
+  atomic<future_continuation*> continuations_;
+  /* Written before the status becomes ready, read after. */
+  bool cancelled_;
+  bool broken_;
+
+ private:
+  future_shared_state_base(const future_shared_state_base& other);
+  void operator=(const future_shared_state_base& other);
+};
+
+/* Shared state with the value stored in-place, so promise costs a single
+ * allocation.
+ */
+template <typename T>
+class future_shared_state : public future_shared_state_base {
+ public:
+  ~future_shared_state() {
+    if (has_value()) {
+      value_pointer()->~T();
+    }
+  }
+
+  void set_value(const T& value) {
+    new (storage_) T(value);
+    mark_ready();
+  }
+
+  inline const T& value() const {
+    assert(has_value());
+    return *value_pointer();
+  }
+
+ protected:
+  inline T *value_pointer() {
+    return reinterpret_cast<T*>(storage_);
+  }
+
+  inline const T *value_pointer() const {
+    return reinterpret_cast<const T*>(storage_);
+  }
+
+  char storage_[sizeof(T)] __attribute__((aligned(__alignof__(T))));
+};
+
+template <>
+class future_shared_state<void> : public future_shared_state_base {
+ public:
+  void set_value() {
+    mark_ready();
+  }
+};
+
+/* Signature of continuation which accepts value of type T. */
+template <typename U, typename T>
+struct continuation_function {
+  typedef function::function<U(T)> type;
+};
+
+template <typename U>
+struct continuation_function<U, void> {
+  typedef function::function<U(void)> type;
+};
+
+/* Invoke continuation and store its result. */
+template <typename U, typename T>
+struct continuation_apply {
+  static void apply(typename continuation_function<U, T>::type& function,
+                    future_shared_state<T> *source,
+                    future_shared_state<U> *result) {
+    result->set_value(function(source->value()));
+  }
+};
+
+template <typename T>
+struct continuation_apply<void, T> {
+  static void apply(typename continuation_function<void, T>::type& function,
+                    future_shared_state<T> *source,
+                    future_shared_state<void> *result) {
+    function(source->value());
+    result->set_value();
+  }
+};
+
+template <typename U>
+struct continuation_apply<U, void> {
+  static void apply(typename continuation_function<U, void>::type& function,
+                    future_shared_state<void> * /*source*/,
+                    future_shared_state<U> *result) {
+    result->set_value(function());
+  }
+};
+
+template <>
+struct continuation_apply<void, void> {
+  static void apply(continuation_function<void, void>::type& function,
+                    future_shared_state<void> * /*source*/,
+                    future_shared_state<void> *result) {
+    function();
+    result->set_value();
+  }
+};
+
+template <typename U, typename T>
+class then_continuation : public future_continuation {
+ public:
+  typedef typename continuation_function<U, T>::type function_type;
+
+  /* Takes ownership over references to both source and result states. */
+  then_continuation(const function_type& function,
+                    executor *executor,
+                    const cancellation_token& token,
+                    future_shared_state<T> *source,
+                    future_shared_state<U> *result)
+      : function_(function),
+        executor_(executor),
+        token_(token),
+        source_(source),
+        result_(result) {}
+
+  ~then_continuation() {
+    source_->release();
+    result_->release();
+  }
+
+  void run() {
+    if (executor_ != NULL && source_->has_value() && !token_.is_cancelled()) {
+      executor_->submit(
+          ::future::bind::function_bind(&then_continuation::execute, this));
+    } else {
+      execute();
+    }
+  }
+
+  /* Cancellation or abandonment of the source and cancellation of the token
+   * are propagated to the result without calling the function.
+   */
+  void execute() {
+    if (!source_->has_value()) {
+      result_->propagate_no_value(source_);
+    } else if (token_.is_cancelled()) {
+      result_->mark_cancelled();
+    } else {
+      continuation_apply<U, T>::apply(function_, source_, result_);
+    }
+    delete this;
+  }
+
+ protected:
+  function_type function_;
+  executor *executor_;
+  cancellation_token token_;
+  future_shared_state<T> *source_;
+  future_shared_state<U> *result_;
+};
+
+/* Functionality shared by all futures regardless of value type. */
+template <typename T>
+class future_base {
+ public:
+  future_base() : state_(NULL) {}
+
+  future_base(const future_base& other) : state_(other.state_) {
+    if (state_ != NULL) {
+      state_->add_reference();
+    }
+  }
+
+  ~future_base() {
+    if (state_ != NULL) {
+      state_->release();
+    }
+  }
+
+  void operator=(const future_base& other) {
+    if (other.state_ != NULL) {
+      other.state_->add_reference();
+    }
+    if (state_ != NULL) {
+      state_->release();
+    }
+    state_ = other.state_;
+  }
+
+  /* Whether future is associated with a shared state. */
+  bool valid() const {
+    return state_ != NULL;
+  }
+
+  /* Non-blocking check whether the value is available. */
+  bool is_ready() const {
+    assert(valid());
+    return state_->is_ready();
+  }
+
+  /* Future is ready but has no value, either the promise was cancelled or
+   * the continuation producing it was skipped because of cancellation.
+   */
+  bool is_cancelled() const {
+    assert(valid());
+    return state_->is_cancelled();
+  }
+
+  /* Future is ready but has no value because its promise (or the promise
+   * of a future it depends on) was destroyed without setting it.
+   */
+  bool is_broken() const {
+    assert(valid());
+    return state_->is_broken();
+  }
+
+  void wait() const {
+    assert(valid());
+    state_->wait();
+  }
+
+  /* Returns false if the value is still not ready after timeout. */
+  bool wait_for(uint64_t timeout_ms) const {
+    assert(valid());
+    return state_->wait_for(timeout_ms);
+  }
+
+ protected:
+  typedef future_shared_state<T> state_type;
+
+  friend struct future_access;
+
+  /* Takes ownership over the state reference. */
+  explicit future_base(state_type *state) : state_(state) {}
+
+  template <typename U>
+  ::future::future<U> then_impl(
+      const typename continuation_function<U, T>::type& function,
+      executor *executor,
+      const cancellation_token& token) const {
+    assert(valid());
+    future_shared_state<U> *result = new future_shared_state<U>();
+    result->add_reference();
+    state_->add_reference();
+    state_->add_continuation(new then_continuation<U, T>(
+        function, executor, token, state_, result));
+    return ::future::future<U>(result);
+  }
+
+  state_type *state_;
+};
+
+template <typename T>
+class promise_base {
+ public:
+  promise_base() : state_(new future_shared_state<T>()) {}
+
+  /* Promise destroyed without a value breaks the future, so waiters wake
+   * up and continuations run (and free the states they reference) instead
+   * of waiting forever.
+   */
+  ~promise_base() {
+    if (!state_->is_ready()) {
+      state_->mark_broken();
+    }
+    state_->release();
+  }
+
+  /* Every call returns a future which shares the same state. */
+  ::future::future<T> get_future() {
+    state_->add_reference();
+    return ::future::future<T>(state_);
+  }
+
+  /* Makes the future ready without a value, to be called instead of
+   * setting the value when the work is abandoned.
+   */
+  void cancel() {
+    state_->mark_cancelled();
+  }
+
+ protected:
+  future_shared_state<T> *state_;
+
+ private:
+  promise_base(const promise_base& other);
+  void operator=(const promise_base& other);
+};
+
+}  /* namespace internal */
+
+/* Result of an asynchronous operation. Futures are copyable, all the copies
+ * share the same state and get() returns the same value for all of them.
+ *
+ * Once the value is ready get() is a single atomic load, waiters sleep on
+ * a futex until the value is set by a promise.
+ *
+ * Continuations attached with then() are run by the thread which sets the
+ * value (or by the caller of then() if the value is ready already), unless
+ * an executor is given to run them on. Continuation is skipped and its
+ * future is cancelled if this future is cancelled, or if the given token
+ * is cancelled by the time the continuation is to run. Likewise, if the
+ * promise is destroyed without setting the value, this future and all of
+ * its continuations become broken.
+ */
+template <typename T>
+class future : public internal::future_base<T> {
+  typedef internal::future_base<T> base_type;
+ public:
+  typedef T value_type;
+
+  future() : base_type() {}
+
+  /* Not to be called on cancelled or broken futures. */
+  const T& get() const {
+    this->wait();
+    return this->state_->value();
+  }
+
+  template <typename U>
+  future<U> then(const function::function<U(T)>& function,
+                 executor *executor = NULL,
+                 const cancellation_token& token = cancellation_token()) const {
+    return this->template then_impl<U>(function, executor, token);
+  }
+
+  template <typename U>
+  future<U> then(internal::function_bind_base<U> *function_bind,
+                 executor *executor = NULL,
+                 const cancellation_token& token = cancellation_token()) const {
+    return this->template then_impl<U>(function::function<U(T)>(function_bind),
+                                       executor,
+                                       token);
+  }
+
+ protected:
+  template <typename> friend class internal::future_base;
+  template <typename> friend class internal::promise_base;
+  friend struct internal::future_access;
+
+  explicit future(typename base_type::state_type *state) : base_type(state) {}
+};
+
+template <>
+class future<void> : public internal::future_base<void> {
+  typedef internal::future_base<void> base_type;
+ public:
+  typedef void value_type;
+
+  future() : base_type() {}
+
+  void get() const {
+    wait();
+  }
+
+  template <typename U>
+  future<U> then(const function::function<U(void)>& function,
+                 executor *executor = NULL,
+                 const cancellation_token& token = cancellation_token()) const {
+    return then_impl<U>(function, executor, token);
+  }
+
+  template <typename U>
+  future<U> then(internal::function_bind_base<U> *function_bind,
+                 executor *executor = NULL,
+                 const cancellation_token& token = cancellation_token()) const {
+    return then_impl<U>(function::function<U(void)>(function_bind),
+                        executor,
+                        token);
+  }
+
+ protected:
+  template <typename> friend class internal::future_base;
+  template <typename> friend class internal::promise_base;
+  friend struct internal::future_access;
+
+  explicit future(base_type::state_type *state) : base_type(state) {}
+};
+
+/* Producer side of a future. Value is to be set exactly once. */
+template <typename T>
+class promise : public internal::promise_base<T> {
+ public:
+  void set_value(const T& value) {
+    this->state_->set_value(value);
+  }
+};
+
+template <>
+class promise<void> : public internal::promise_base<void> {
+ public:
+  void set_value() {
+    state_->set_value();
+  }
+};
+
+template <typename T>
+future<T> make_ready_future(const T& value) {
+  promise<T> result;
+  result.set_value(value);
+  return result.get_future();
+}
+
+inline future<void> make_ready_future() {
+  promise<void> result;
+  result.set_value();
+  return result.get_future();
+}
+
+namespace internal {
+
+/* Gives combinators access to the shared state of futures. */
+struct future_access {
+  template <typename T>
+  static future_shared_state<T> *state(const future_base<T>& future) {
+    return future.state_;
+  }
+
+  /* Takes ownership over the state reference. */
+  template <typename T>
+  static ::future::future<T> make_future(future_shared_state<T> *state) {
+    return ::future::future<T>(state);
+  }
+};
+
+/* Common part of when_all() and when_any(): a continuation is attached to
+ * every input and finished inputs are counted down with a single atomic.
+ * Continuations are allocated together, so combining any number of
+ * futures costs a fixed number of allocations and takes no locks.
+ */
+template <typename T>
+class future_combinator_state {
+ public:
+  template <typename Iterator>
+  future_combinator_state(Iterator begin, Iterator end)
+      : inputs_(begin, end),
+        continuations_(NULL),
+        num_remaining_(inputs_.size()) {}
+
+  virtual ~future_combinator_state() {
+    delete [] continuations_;
+  }
+
+  /* The state deletes itself once all the inputs are ready, so it is not
+   * to be accessed after this call.
+   */
+  void start() {
+    size_t num_inputs = inputs_.size();
+    input_continuation *continuations = new input_continuation[num_inputs];
+    continuations_ = continuations;
+    for (size_t i = 0; i < num_inputs; ++i) {
+      continuations[i].owner = this;
+      continuations[i].index = i;
+    }
+    for (size_t i = 0; i < num_inputs; ++i) {
+      future_access::state(inputs_[i])->add_continuation(&continuations[i]);
+    }
+  }
+
+ protected:
+  class input_continuation : public future_continuation {
+   public:
+    void run() {
+      owner->input_ready(index);
+    }
+
+    future_combinator_state *owner;
+    size_t index;
+  };
+
+  /* num_remaining is the number of pending inputs including this one. */
+  virtual void on_input_ready(size_t index, size_t num_remaining) = 0;
+
+  void input_ready(size_t index) {
+    size_t num_remaining = num_remaining_.fetch_sub(1, memory_order_acq_rel);
+    on_input_ready(index, num_remaining);
+    if (num_remaining == 1) {
+      delete this;
+    }
+  }
+
+  std::vector< ::future::future<T> > inputs_;
+  input_continuation *continuations_;
+  atomic<size_t> num_remaining_;
+};
+
+template <typename T>
+struct when_all_result {
+  typedef std::vector<T> type;
+};
+
+template <>
+struct when_all_result<void> {
+  typedef void type;
+};
+
+template <typename T>
+struct when_all_collect {
+  static void apply(const std::vector< ::future::future<T> >& inputs,
+                    future_shared_state<std::vector<T> > *result) {
+    std::vector<T> values;
+    values.reserve(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      future_shared_state<T> *input = future_access::state(inputs[i]);
+      if (!input->has_value()) {
+        result->propagate_no_value(input);
+        return;
+      }
+      values.push_back(input->value());
+    }
+    result->set_value(values);
+  }
+};
+
+template <>
+struct when_all_collect<void> {
+  static void apply(const std::vector< ::future::future<void> >& inputs,
+                    future_shared_state<void> *result) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      future_shared_state<void> *input = future_access::state(inputs[i]);
+      if (!input->has_value()) {
+        result->propagate_no_value(input);
+        return;
+      }
+    }
+    result->set_value();
+  }
+};
+
+template <typename T>
+class when_all_state : public future_combinator_state<T> {
+ public:
+  typedef future_shared_state<typename when_all_result<T>::type> result_type;
+
+  /* Takes ownership over the result state reference. */
+  template <typename Iterator>
+  when_all_state(Iterator begin, Iterator end, result_type *result)
+      : future_combinator_state<T>(begin, end),
+        result_(result) {}
+
+  ~when_all_state() {
+    result_->release();
+  }
+
+ protected:
+  void on_input_ready(size_t /*index*/, size_t num_remaining) {
+    if (num_remaining == 1) {
+      when_all_collect<T>::apply(this->inputs_, result_);
+    }
+  }
+
+  result_type *result_;
+};
+
+template <typename T>
+class when_any_state : public future_combinator_state<T> {
+ public:
+  typedef future_shared_state<size_t> result_type;
+
+  /* Takes ownership over the result state reference. */
+  template <typename Iterator>
+  when_any_state(Iterator begin, Iterator end, result_type *result)
+      : future_combinator_state<T>(begin, end),
+        result_(result) {}
+
+  ~when_any_state() {
+    result_->release();
+  }
+
+ protected:
+  void on_input_ready(size_t index, size_t num_remaining) {
+    if (num_remaining == this->inputs_.size()) {
+      result_->set_value(index);
+    }
+  }
+
+  result_type *result_;
+};
+
+template <typename Iterator>
+struct combinator_value_type {
+  typedef typename std::iterator_traits<Iterator>::value_type::value_type type;
+};
+
+}  /* namespace internal */
+
+/* Future which becomes ready once all the futures from the range are ready.
+ * Its value is a vector of values of the futures (or void for a range of
+ * void futures). If any of the futures is cancelled or broken, the result
+ * is cancelled or broken the same way.
+ */
+template <typename Iterator>
+future<typename internal::when_all_result<
+    typename internal::combinator_value_type<Iterator>::type>::type>
+when_all(Iterator begin, Iterator end) {
+  typedef typename internal::combinator_value_type<Iterator>::type T;
+  typedef internal::when_all_state<T> state_type;
+  typename state_type::result_type *result =
+      new typename state_type::result_type();
+  result->add_reference();
+  state_type *state = new state_type(begin, end, result);
+  if (begin == end) {
+    internal::when_all_collect<T>::apply(
+        std::vector< ::future::future<T> >(), result);
+    delete state;
+  } else {
+    state->start();
+  }
+  return internal::future_access::make_future(result);
+}
+
+/* Future which becomes ready once any of the futures from the range is
+ * ready, its value is the index of that future in the range. For an empty
+ * range the index is 0, which is the end of the range.
+ */
+template <typename Iterator>
+future<size_t> when_any(Iterator begin, Iterator end) {
+  typedef typename internal::combinator_value_type<Iterator>::type T;
+  typedef internal::when_any_state<T> state_type;
+  typename state_type::result_type *result =
+      new typename state_type::result_type();
+  result->add_reference();
+  state_type *state = new state_type(begin, end, result);
+  if (begin == end) {
+    result->set_value(0);
+    delete state;
+  } else {
+    state->start();
+  }
+  return internal::future_access::make_future(result);
+}
+
+}  /* namespace future */
+
+#endif  /* FUTURE_FUTURE_H_ */
@@ -0,0 +1,326 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_HAZARD_POINTER_H_
+#define FUTURE_HAZARD_POINTER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/mutex.h"
+#include "future/thread_specific.h"
+
+namespace future {
+
+class hazard_domain;
+
+namespace internal {
+
+typedef void (*hazard_deleter)(void *pointer);
+
+template <typename T>
+void hazard_delete(void *pointer) {
+  delete static_cast<T*>(pointer);
+}
+
+struct hazard_retired {
+  void *pointer;
+  hazard_deleter deleter;
+};
+
+/* Hazard slot, owned by at most one hazard_pointer at a time. Slots are
+ * never freed while the domain is alive.
+ */
+struct hazard_record {
+  hazard_record() : pointer(NULL), in_use(1), next(NULL) {}
+
+  atomic<void*> pointer;
+  atomic<int> in_use;
+  hazard_record *next;
+  char pad_[FUTURE_CACHELINE_SIZE];
+};
+
+struct hazard_retired_list {
+  explicit hazard_retired_list(hazard_domain *domain) : domain(domain) {}
+
+  hazard_domain *domain;
+  std::vector<hazard_retired> retired;
+};
+
+inline void hazard_retired_list_release(hazard_retired_list *list);
+
+}  /* namespace internal */
+
+/* Hazard pointer reclamation domain.
+ *
+ * Reader publishes the pointer it's about to dereference in a hazard slot,
+ * writers retire unlinked nodes to a per-thread list. Once the list grows
+ * past a threshold proportional to the number of slots it's scanned and
+ * every node which is not published in any slot is freed, so the amount of
+ * garbage is bounded even if a reader stalls, unlike with epochs.
+ *
+ * With R slots in the domain a scan starts once 2R nodes are retired and
+ * at most R of them can be protected, so every scan frees at least half of
+ * the list and retiring costs amortized O(1) slot reads per node.
+ *
+ * Lifetime rules are the same as for the epoch domain.
+ */
+class hazard_domain {
+ public:
+  typedef internal::hazard_deleter deleter_type;
+
+  hazard_domain()
+      : records_(NULL),
+        num_records_(0),
+        num_orphans_(0),
+        orphans_mutex_("hazard_orphans"),
+        retired_(internal::hazard_retired_list_release) {}
+
+  /* No node of the domain is to be protected any more. */
+  ~hazard_domain() {
+    /* Lists are freed here, not by the thread exit cleanup. */
+    internal::hazard_retired_list *list = retired_.release();
+    if (list != NULL) {
+      free_all(&list->retired);
+      delete list;
+    }
+    free_all(&orphans_);
+    internal::hazard_record *record = records_.load();
+    while (record != NULL) {
+      internal::hazard_record *next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+
+  /* Node is to be unlinked already, so new readers can't reach it. */
+  void retire(void *pointer, deleter_type deleter) {
+    internal::hazard_retired_list *list = current_list();
+    internal::hazard_retired retired = {pointer, deleter};
+    list->retired.push_back(retired);
+    if (list->retired.size() >= scan_threshold()) {
+      scan(&list->retired);
+    }
+  }
+
+  template <typename T>
+  void retire(T *pointer) {
+    retire(pointer, internal::hazard_delete<T>);
+  }
+
+  /* Frees all retired nodes of the calling thread and of exited threads
+   * which are not protected.
+   */
+  void collect() {
+    scan(&current_list()->retired);
+  }
+
+  /* Domain used by hazard_pointer unless told otherwise. Every slot ever
+   * acquired from it stays allocated, so it's meant for long-lived
+   * structures rather than per-object domains.
+   */
+  static hazard_domain& default_domain() {
+    static hazard_domain *domain = new hazard_domain();
+    return *domain;
+  }
+
+ protected:
+  friend class hazard_pointer;
+  friend void internal::hazard_retired_list_release(
+      internal::hazard_retired_list *list);
+
+  enum { min_scan_threshold = 64 };
+
+  size_t scan_threshold() const {
+    size_t threshold = 2 * (size_t)num_records_.load(
+        internal::memory_order_relaxed);
+    return std::max(threshold, (size_t)min_scan_threshold);
+  }
+
+  internal::hazard_record *acquire_record() {
+    for (internal::hazard_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      int in_use = 0;
+      if (record->in_use.load(internal::memory_order_relaxed) == 0 &&
+          record->in_use.compare_exchange_strong(in_use, 1)) {
+        return record;
+      }
+    }
+    internal::hazard_record *record = new internal::hazard_record();
+    internal::hazard_record *head = records_.load();
+    do {
+      record->next = head;
+    } while (!records_.compare_exchange_weak(head, record));
+    num_records_.fetch_add(1, internal::memory_order_relaxed);
+    return record;
+  }
+
+  void release_record(internal::hazard_record *record) {
+    record->pointer.store(NULL, internal::memory_order_release);
+    record->in_use.store(0, internal::memory_order_release);
+  }
+
+  internal::hazard_retired_list *current_list() {
+    internal::hazard_retired_list *list = retired_.get();
+    if (list == NULL) {
+      list = new internal::hazard_retired_list(this);
+      retired_.reset(list);
+    }
+    return list;
+  }
+
+  /* Nodes the exiting thread did not get to free become orphans, the next
+   * scan by any thread takes them over.
+   */
+  void release_list(internal::hazard_retired_list *list) {
+    if (!list->retired.empty()) {
+      mutex::scoped_lock lock(orphans_mutex_);
+      orphans_.insert(orphans_.end(),
+                      list->retired.begin(),
+                      list->retired.end());
+      num_orphans_.store((int)orphans_.size(),
+                         internal::memory_order_relaxed);
+    }
+    delete list;
+  }
+
+  void scan(std::vector<internal::hazard_retired> *retired) {
+    if (num_orphans_.load(internal::memory_order_relaxed) != 0) {
+      mutex::scoped_lock lock(orphans_mutex_);
+      retired->insert(retired->end(), orphans_.begin(), orphans_.end());
+      orphans_.clear();
+      num_orphans_.store(0, internal::memory_order_relaxed);
+    }
+    /* Pairs with the fence in hazard_pointer::protect(): either the reader
+     * sees the node is unlinked or we see its hazard.
+     */
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    std::vector<void*> hazards;
+    for (internal::hazard_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      void *pointer = record->pointer.load(internal::memory_order_acquire);
+      if (pointer != NULL) {
+        hazards.push_back(pointer);
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    size_t num_kept = 0;
+    for (size_t i = 0; i < retired->size(); ++i) {
+      internal::hazard_retired current = (*retired)[i];
+      if (std::binary_search(hazards.begin(), hazards.end(),
+                             current.pointer)) {
+        (*retired)[num_kept++] = current;
+      } else {
+        current.deleter(current.pointer);
+      }
+    }
+    retired->resize(num_kept);
+  }
+
+  static void free_all(std::vector<internal::hazard_retired> *retired) {
+    for (size_t i = 0; i < retired->size(); ++i) {
+      (*retired)[i].deleter((*retired)[i].pointer);
+    }
+    retired->clear();
+  }
+
+  internal::atomic<internal::hazard_record*> records_;
+  internal::atomic<int> num_records_;
+
+  /* Retired nodes of exited threads. */
+  internal::atomic<int> num_orphans_;
+  mutex orphans_mutex_;
+  std::vector<internal::hazard_retired> orphans_;
+
+  thread_specific_ptr<internal::hazard_retired_list> retired_;
+
+ private:
+  hazard_domain(const hazard_domain& other);
+  void operator=(const hazard_domain& other);
+};
+
+/* Owner of a hazard slot. Protecting a pointer guarantees the node is not
+ * freed until the protection is reset or replaced.
+ */
+class hazard_pointer {
+ public:
+  explicit hazard_pointer(
+      hazard_domain& domain = hazard_domain::default_domain())
+      : domain_(domain),
+        record_(domain.acquire_record()) {}
+
+  ~hazard_pointer() {
+    domain_.release_record(record_);
+  }
+
+  /* Loads the pointer from the source and protects it, retrying until the
+   * source still holds the same pointer after the hazard is published.
+   */
+  template <typename T>
+  T *protect(const internal::atomic<T*>& source) {
+    T *pointer = source.load(internal::memory_order_relaxed);
+    for (;;) {
+      record_->pointer.store(pointer, internal::memory_order_relaxed);
+      internal::atomic_thread_fence(internal::memory_order_seq_cst);
+      T *current = source.load(internal::memory_order_acquire);
+      if (current == pointer) {
+        return pointer;
+      }
+      pointer = current;
+    }
+  }
+
+  /* Protects a pointer which is known to be not retired yet. */
+  void reset(const void *pointer) {
+    record_->pointer.store(const_cast<void*>(pointer),
+                           internal::memory_order_relaxed);
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+  }
+
+  void reset() {
+    record_->pointer.store(NULL, internal::memory_order_release);
+  }
+
+ protected:
+  hazard_domain& domain_;
+  internal::hazard_record *record_;
+
+ private:
+  hazard_pointer(const hazard_pointer& other);
+  void operator=(const hazard_pointer& other);
+};
+
+namespace internal {
+
+inline void hazard_retired_list_release(hazard_retired_list *list) {
+  list->domain->release_list(list);
+}
+
+}  /* namespace internal */
+
+}  /* namespace future */
+
+#endif  /* FUTURE_HAZARD_POINTER_H_ */
@@ -0,0 +1,143 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_LATCH_H_
+#define FUTURE_LATCH_H_
+
+#include <stdint.h>
+#include <cassert>
+
+#include "future/atomic.h"
+#include "future/clock.h"
+#include "future/futex.h"
+
+namespace future {
+
+/* Single-use countdown, waiters are released once the counter reaches
+ * zero. Waiters spin for a short while and then sleep on a futex.
+ */
+class latch {
+ public:
+  explicit latch(int count)
+      : count_(count * count_increment) {
+    assert(count >= 0);
+  }
+
+  void count_down(int n = 1) {
+    int previous = count_.fetch_sub(n * count_increment,
+                                    internal::memory_order_acq_rel);
+    assert((previous & ~has_sleepers) >= n * count_increment);
+    /* Nothing but the wake up is done after the counter reaches zero,
+     * released threads might destroy the latch right away.
+     */
+    if ((previous & ~has_sleepers) == n * count_increment &&
+        (previous & has_sleepers) != 0) {
+      internal::futex_wake_all(count_.address());
+    }
+  }
+
+  bool try_wait() const {
+    return (count_.load(internal::memory_order_acquire) & ~has_sleepers) == 0;
+  }
+
+  void wait() {
+    if (spin_wait()) {
+      return;
+    }
+    int count;
+    while (prepare_sleep(&count)) {
+      internal::futex_wait(count_.address(), count);
+    }
+  }
+
+  /* Returns false if the counter did not reach zero in time. */
+  bool wait_for(uint64_t timeout_ms) {
+    if (spin_wait()) {
+      return true;
+    }
+    uint64_t deadline =
+        internal::monotonic_time_ns() + timeout_ms * 1000000ULL;
+    int count;
+    while (prepare_sleep(&count)) {
+      uint64_t now = internal::monotonic_time_ns();
+      if (now >= deadline) {
+        return false;
+      }
+      internal::futex_wait_for(count_.address(), count, deadline - now);
+    }
+    return true;
+  }
+
+  void arrive_and_wait(int n = 1) {
+    count_down(n);
+    wait();
+  }
+
+ protected:
+  enum { num_spins = 1024 };
+
+  /* Counter is stored shifted, lowest bit tells whether anyone is sleeping
+   * on the counter word.
+   */
+  enum {
+    has_sleepers = 1,
+    count_increment = 2
+  };
+
+  bool spin_wait() const {
+    for (int i = 0; i < num_spins; ++i) {
+      if (try_wait()) {
+        return true;
+      }
+      internal::cpu_relax();
+    }
+    return false;
+  }
+
+  /* Marks the counter as having sleepers, returns false if it reached zero
+   * already.
+   */
+  bool prepare_sleep(int *count) {
+    for (;;) {
+      int current = count_.load(internal::memory_order_acquire);
+      if ((current & ~has_sleepers) == 0) {
+        return false;
+      }
+      if ((current & has_sleepers) != 0 ||
+          count_.compare_exchange_strong(current, current | has_sleepers,
+                                         internal::memory_order_acq_rel)) {
+        *count = current | has_sleepers;
+        return true;
+      }
+    }
+  }
+
+  internal::atomic<int> count_;
+
+ private:
+  latch(const latch& other);
+  void operator=(const latch& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_LATCH_H_ */
@@ -0,0 +1,290 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_LOCK_STATS_H_
+#define FUTURE_LOCK_STATS_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <pthread.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <stdint.h>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "future/atomic.h"
+
+namespace future {
+
+class lock_stats;
+
+namespace internal {
+
+/* Accumulated contention profile of all the mutexes which share the same
+ * name. Profiles are never freed, so mutexes can keep raw pointers to them.
+ */
+class lock_profile {
+ public:
+  /* Hold time histogram bucket i counts hold times in [2^i, 2^(i+1)) ns,
+   * the last bucket also gets everything above.
+   */
+  enum { num_hold_buckets = 32 };
+
+  explicit lock_profile(const char *name)
+      : name_(name),
+        next_(NULL) {}
+
+  inline void record_acquire(bool contended, uint64_t wait_ns) {
+    acquisitions_.fetch_add(1, memory_order_relaxed);
+    if (contended) {
+      contended_.fetch_add(1, memory_order_relaxed);
+      wait_total_ns_.fetch_add(wait_ns, memory_order_relaxed);
+      wait_max_ns_.fetch_max(wait_ns);
+    }
+  }
+
+  inline void record_release(uint64_t hold_ns) {
+    hold_histogram_[hold_bucket(hold_ns)].fetch_add(1, memory_order_relaxed);
+  }
+
+  void reset() {
+    acquisitions_.store(0, memory_order_relaxed);
+    contended_.store(0, memory_order_relaxed);
+    wait_total_ns_.store(0, memory_order_relaxed);
+    wait_max_ns_.store(0, memory_order_relaxed);
+    for (int i = 0; i < num_hold_buckets; ++i) {
+      hold_histogram_[i].store(0, memory_order_relaxed);
+    }
+  }
+
+  static inline int hold_bucket(uint64_t hold_ns) {
+    if (hold_ns == 0) {
+      return 0;
+    }
+    int bucket = 63 - __builtin_clzll(hold_ns);
+    return std::min(bucket, (int)num_hold_buckets - 1);
+  }
+
+ protected:
+  friend class ::future::lock_stats;
+  friend lock_profile *lock_profile_register(const char *name);
+
+  std::string name_;
+  atomic<uint64_t> acquisitions_;
+  atomic<uint64_t> contended_;
+  atomic<uint64_t> wait_total_ns_;
+  atomic<uint64_t> wait_max_ns_;
+  atomic<uint64_t> hold_histogram_[num_hold_buckets];
+  lock_profile *next_;
+};
+
+inline pthread_mutex_t *lock_profile_registry_mutex() {
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  return &mutex;
+}
+
+inline lock_profile **lock_profile_registry_head() {
+  static lock_profile *head = NULL;
+  return &head;
+}
+
+/* Get profile for the given lock name, creating it if needed. */
+inline lock_profile *lock_profile_register(const char *name) {
+  if (name == NULL) {
+    name = "<unnamed>";
+  }
+  pthread_mutex_lock(lock_profile_registry_mutex());
+  lock_profile **head = lock_profile_registry_head();
+  lock_profile *profile;
+  for (profile = *head; profile != NULL; profile = profile->next_) {
+    if (profile->name_ == name) {
+      break;
+    }
+  }
+  if (profile == NULL) {
+    profile = new lock_profile(name);
+    profile->next_ = *head;
+    *head = profile;
+  }
+  pthread_mutex_unlock(lock_profile_registry_mutex());
+  return profile;
+}
+
+}  /* namespace internal */
+
+/* Access to the contention statistics collected by mutexes when the library
+ * is compiled with FUTURE_MUTEX_PROFILING defined. Statistics is aggregated
+ * per lock name, see mutex(const char *name).
+ */
+class lock_stats {
+ public:
+  struct entry {
+    std::string name;
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t wait_total_ns;
+    uint64_t wait_max_ns;
+    uint64_t hold_histogram[internal::lock_profile::num_hold_buckets];
+  };
+
+  /* Get current statistics of all known locks, sorted by total wait time,
+   * so the worst bottleneck goes first.
+   */
+  static void snapshot(std::vector<entry> *entries) {
+    using internal::lock_profile;
+    using internal::memory_order_relaxed;
+    entries->clear();
+    pthread_mutex_lock(internal::lock_profile_registry_mutex());
+    for (lock_profile *profile = *internal::lock_profile_registry_head();
+         profile != NULL;
+         profile = profile->next_) {
+      entry e;
+      e.name = profile->name_;
+      e.acquisitions = profile->acquisitions_.load(memory_order_relaxed);
+      e.contended = profile->contended_.load(memory_order_relaxed);
+      e.wait_total_ns = profile->wait_total_ns_.load(memory_order_relaxed);
+      e.wait_max_ns = profile->wait_max_ns_.load(memory_order_relaxed);
+      for (int i = 0; i < lock_profile::num_hold_buckets; ++i) {
+        e.hold_histogram[i] =
+            profile->hold_histogram_[i].load(memory_order_relaxed);
+      }
+      entries->push_back(e);
+    }
+    pthread_mutex_unlock(internal::lock_profile_registry_mutex());
+    std::sort(entries->begin(), entries->end(), compare_wait_total);
+  }
+
+  /* Human readable report. */
+  static std::string dump_text() {
+    std::vector<entry> entries;
+    snapshot(&entries);
+    std::string result;
+    char buffer[256];
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const entry& e = entries[i];
+      double contended_percent = e.acquisitions != 0
+          ? 100.0 * e.contended / e.acquisitions
+          : 0.0;
+      snprintf(buffer, sizeof(buffer),
+               "lock \"%s\": acquisitions=%llu contended=%llu (%.2f%%) "
+               "wait_total=%.3fms wait_max=%.3fms\n",
+               e.name.c_str(),
+               (unsigned long long)e.acquisitions,
+               (unsigned long long)e.contended,
+               contended_percent,
+               e.wait_total_ns / 1e6,
+               e.wait_max_ns / 1e6);
+      result += buffer;
+      for (int j = 0; j < internal::lock_profile::num_hold_buckets; ++j) {
+        if (e.hold_histogram[j] == 0) {
+          continue;
+        }
+        snprintf(buffer, sizeof(buffer),
+                 "  hold >= %12lluns: %llu\n",
+                 1ULL << j,
+                 (unsigned long long)e.hold_histogram[j]);
+        result += buffer;
+      }
+    }
+    return result;
+  }
+
+  /* Machine readable report, an array of objects, one per lock name.
+   * Bucket i of hold_histogram_ns counts hold times in [2^i, 2^(i+1)) ns.
+   */
+  static std::string dump_json() {
+    std::vector<entry> entries;
+    snapshot(&entries);
+    std::string result = "[";
+    char buffer[256];
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const entry& e = entries[i];
+      if (i != 0) {
+        result += ",";
+      }
+      result += "\n  {\"name\": ";
+      append_json_string(e.name, &result);
+      snprintf(buffer, sizeof(buffer),
+               ", \"acquisitions\": %llu, \"contended\": %llu, "
+               "\"wait_total_ns\": %llu, \"wait_max_ns\": %llu, "
+               "\"hold_histogram_ns\": [",
+               (unsigned long long)e.acquisitions,
+               (unsigned long long)e.contended,
+               (unsigned long long)e.wait_total_ns,
+               (unsigned long long)e.wait_max_ns);
+      result += buffer;
+      for (int j = 0; j < internal::lock_profile::num_hold_buckets; ++j) {
+        snprintf(buffer, sizeof(buffer), "%s%llu",
+                 j != 0 ? ", " : "",
+                 (unsigned long long)e.hold_histogram[j]);
+        result += buffer;
+      }
+      result += "]}";
+    }
+    result += entries.empty() ? "]\n" : "\n]\n";
+    return result;
+  }
+
+  /* Zero all the counters, lock names are kept. */
+  static void reset() {
+    pthread_mutex_lock(internal::lock_profile_registry_mutex());
+    for (internal::lock_profile *profile =
+             *internal::lock_profile_registry_head();
+         profile != NULL;
+         profile = profile->next_) {
+      profile->reset();
+    }
+    pthread_mutex_unlock(internal::lock_profile_registry_mutex());
+  }
+
+ protected:
+  static bool compare_wait_total(const entry& a, const entry& b) {
+    return a.wait_total_ns > b.wait_total_ns;
+  }
+
+  static void append_json_string(const std::string& str,
+                                 std::string *result) {
+    *result += '"';
+    for (size_t i = 0; i < str.size(); ++i) {
+      unsigned char ch = str[i];
+      if (ch == '"' || ch == '\\') {
+        *result += '\\';
+        *result += ch;
+      } else if (ch < 0x20) {
+        char buffer[8];
+        snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+        *result += buffer;
+      } else {
+        *result += ch;
+      }
+    }
+    *result += '"';
+  }
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_LOCK_STATS_H_ */
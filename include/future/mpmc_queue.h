@@ -0,0 +1,235 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_MPMC_QUEUE_H_
+#define FUTURE_MPMC_QUEUE_H_
+
+#include <cstddef>
+
+#include "future/atomic.h"
+#include "future/futex.h"
+
+namespace future {
+
+/* Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Ring buffer where every slot has a sequence number telling whether the
+ * slot is ready to be written or read for the current lap (algorithm by
+ * Dmitry Vyukov). Producers and consumers only contend on their own index.
+ *
+ * Blocking push() and pop() spin briefly and then park on a futex, the
+ * non-blocking side only does a system call when someone is parked.
+ *
+ * T is to be default constructible and assignable.
+ */
+template <typename T>
+class mpmc_queue {
+ public:
+  /* Capacity is rounded up to a power of two. */
+  explicit mpmc_queue(size_t capacity)
+      : head_(0),
+        tail_(0),
+        not_empty_epoch_(0),
+        num_pop_waiters_(0),
+        not_full_epoch_(0),
+        num_push_waiters_(0) {
+    capacity_ = 2;
+    while (capacity_ < capacity) {
+      capacity_ *= 2;
+    }
+    mask_ = capacity_ - 1;
+    cells_ = new cell[capacity_];
+    for (size_t i = 0; i < capacity_; ++i) {
+      cells_[i].sequence.store(i, internal::memory_order_relaxed);
+    }
+  }
+
+  ~mpmc_queue() {
+    delete [] cells_;
+  }
+
+  /* Returns false if the queue is full. */
+  bool try_push(const T& value) {
+    if (!push_nowake(value)) {
+      return false;
+    }
+    wake(&not_empty_epoch_, &num_pop_waiters_);
+    return true;
+  }
+
+  /* Returns false if the queue is empty. */
+  bool try_pop(T *value) {
+    if (!pop_nowake(value)) {
+      return false;
+    }
+    wake(&not_full_epoch_, &num_push_waiters_);
+    return true;
+  }
+
+  /* Blocks while the queue is full. */
+  void push(const T& value) {
+    for (int i = 0; i < num_spins; ++i) {
+      if (try_push(value)) {
+        return;
+      }
+      internal::cpu_relax();
+    }
+    for (;;) {
+      int epoch = not_full_epoch_.load(internal::memory_order_acquire);
+      num_push_waiters_.fetch_add(1);
+      bool pushed = push_nowake(value);
+      if (!pushed) {
+        internal::futex_wait(not_full_epoch_.address(), epoch);
+      }
+      num_push_waiters_.fetch_sub(1);
+      if (pushed) {
+        wake(&not_empty_epoch_, &num_pop_waiters_);
+        return;
+      }
+    }
+  }
+
+  /* Blocks while the queue is empty. */
+  void pop(T *value) {
+    for (int i = 0; i < num_spins; ++i) {
+      if (try_pop(value)) {
+        return;
+      }
+      internal::cpu_relax();
+    }
+    for (;;) {
+      int epoch = not_empty_epoch_.load(internal::memory_order_acquire);
+      num_pop_waiters_.fetch_add(1);
+      bool popped = pop_nowake(value);
+      if (!popped) {
+        internal::futex_wait(not_empty_epoch_.address(), epoch);
+      }
+      num_pop_waiters_.fetch_sub(1);
+      if (popped) {
+        wake(&not_full_epoch_, &num_push_waiters_);
+        return;
+      }
+    }
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+ protected:
+  enum { num_spins = 128 };
+
+  struct cell {
+    internal::atomic<size_t> sequence;
+    T value;
+  };
+
+  bool push_nowake(const T& value) {
+    using internal::memory_order_acquire;
+    using internal::memory_order_relaxed;
+    using internal::memory_order_release;
+    size_t position = tail_.load(memory_order_relaxed);
+    cell *current;
+    for (;;) {
+      current = &cells_[position & mask_];
+      size_t sequence = current->sequence.load(memory_order_acquire);
+      ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+      if (difference == 0) {
+        if (tail_.compare_exchange_weak(position, position + 1,
+                                        memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        /* Slot is not consumed yet from the previous lap. */
+        return false;
+      } else {
+        position = tail_.load(memory_order_relaxed);
+      }
+    }
+    current->value = value;
+    current->sequence.store(position + 1, memory_order_release);
+    return true;
+  }
+
+  bool pop_nowake(T *value) {
+    using internal::memory_order_acquire;
+    using internal::memory_order_relaxed;
+    using internal::memory_order_release;
+    size_t position = head_.load(memory_order_relaxed);
+    cell *current;
+    for (;;) {
+      current = &cells_[position & mask_];
+      size_t sequence = current->sequence.load(memory_order_acquire);
+      ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+      if (difference == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        /* Slot is not written yet in this lap. */
+        return false;
+      } else {
+        position = head_.load(memory_order_relaxed);
+      }
+    }
+    *value = current->value;
+    current->sequence.store(position + mask_ + 1, memory_order_release);
+    return true;
+  }
+
+  /* Waiters announce themselves before re-checking the queue, so either
+   * they see the change or we see them here.
+   */
+  static void wake(internal::atomic<int> *epoch,
+                   internal::atomic<int> *num_waiters) {
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    if (num_waiters->load(internal::memory_order_relaxed) != 0) {
+      epoch->fetch_add(1);
+      internal::futex_wake(epoch->address(), 1);
+    }
+  }
+
+  cell *cells_;
+  size_t capacity_;
+  size_t mask_;
+
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<size_t> head_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<size_t> tail_;
+  char pad2_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<int> not_empty_epoch_;
+  internal::atomic<int> num_pop_waiters_;
+  char pad3_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<int> not_full_epoch_;
+  internal::atomic<int> num_push_waiters_;
+  char pad4_[FUTURE_CACHELINE_SIZE];
+
+ private:
+  mpmc_queue(const mpmc_queue& other);
+  void operator=(const mpmc_queue& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_MPMC_QUEUE_H_ */
@@ -29,6 +29,15 @@
 #  error "Unsupported threading model on your system"
 #endif
 
+/* Define FUTURE_MUTEX_PROFILING to make mutexes collect contention
+ * statistics, available via future::lock_stats. The define must be the
+ * same for all the translation units since it changes the mutex layout.
+ */
+#ifdef FUTURE_MUTEX_PROFILING
+#  include "future/clock.h"
+#  include "future/lock_stats.h"
+#endif
+
 namespace future {
 
 class condition_variable;
@@ -75,12 +84,54 @@ class mutex {
 
   mutex() {
     pthread_mutex_init(&mutex_, NULL);
+#ifdef FUTURE_MUTEX_PROFILING
+    profile_ = internal::lock_profile_register(NULL);
+#endif
+  }
+
+  /* Name is used to aggregate contention statistics in profiling builds,
+   * it's ignored otherwise.
+   */
+  explicit mutex(const char *name) {
+    pthread_mutex_init(&mutex_, NULL);
+#ifdef FUTURE_MUTEX_PROFILING
+    profile_ = internal::lock_profile_register(name);
+#else
+    (void)name;
+#endif
   }
 
   ~mutex() {
     pthread_mutex_destroy(&mutex_);
   }
 
+#ifdef FUTURE_MUTEX_PROFILING
+  void lock() {
+    if (pthread_mutex_trylock(&mutex_) == 0) {
+      profile_->record_acquire(false, 0);
+    } else {
+      uint64_t wait_start = internal::monotonic_time_ns();
+      pthread_mutex_lock(&mutex_);
+      profile_->record_acquire(true,
+                               internal::monotonic_time_ns() - wait_start);
+    }
+    profile_hold_begin();
+  }
+
+  void unlock() {
+    profile_hold_end();
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  bool try_lock() {
+    if (pthread_mutex_trylock(&mutex_) == 0) {
+      profile_->record_acquire(false, 0);
+      profile_hold_begin();
+      return true;
+    }
+    return false;
+  }
+#else
   void lock() {
     pthread_mutex_lock(&mutex_);
   }
@@ -92,9 +143,27 @@ class mutex {
   bool try_lock() {
     return (pthread_mutex_trylock(&mutex_) == 0);
   }
+#endif
 
  protected:
   friend class condition_variable;
+
+#ifdef FUTURE_MUTEX_PROFILING
+  /* Hold time accounting, also used by condition variable which releases
+   * the mutex for the duration of wait.
+   */
+  inline void profile_hold_begin() {
+    hold_start_ = internal::monotonic_time_ns();
+  }
+
+  inline void profile_hold_end() {
+    profile_->record_release(internal::monotonic_time_ns() - hold_start_);
+  }
+
+  internal::lock_profile *profile_;
+  uint64_t hold_start_;
+#endif
+
   pthread_mutex_t mutex_;
 };
 
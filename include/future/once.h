@@ -0,0 +1,141 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_ONCE_H_
+#define FUTURE_ONCE_H_
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/futex.h"
+
+namespace future {
+
+namespace internal {
+struct once_access;
+}  /* namespace internal */
+
+/* Flag for call_once(), is to be shared by all the callers. */
+class once_flag {
+ public:
+  once_flag() : state_(state_initial) {}
+
+  /* True once the function finished running. */
+  bool done() const {
+    return state_.load(internal::memory_order_acquire) == state_done;
+  }
+
+ protected:
+  friend struct internal::once_access;
+
+  enum {
+    state_initial = 0,
+    state_running = 1,
+    state_running_with_waiters = 2,
+    state_done = 3
+  };
+
+  /* Returns true if the caller is to run the function, otherwise waits
+   * for the function to be finished by another thread.
+   */
+  bool begin() {
+    using internal::memory_order_acquire;
+    for (;;) {
+      int state = state_.load(memory_order_acquire);
+      if (state == state_done) {
+        return false;
+      }
+      if (state == state_initial) {
+        if (state_.compare_exchange_strong(state, state_running,
+                                           memory_order_acquire)) {
+          return true;
+        }
+        continue;
+      }
+      if (state == state_running &&
+          !state_.compare_exchange_strong(state, state_running_with_waiters,
+                                          memory_order_acquire)) {
+        continue;
+      }
+      internal::futex_wait(state_.address(), state_running_with_waiters);
+    }
+  }
+
+  void finish() {
+    int state = state_.exchange(state_done, internal::memory_order_release);
+    if (state == state_running_with_waiters) {
+      internal::futex_wake_all(state_.address());
+    }
+  }
+
+  internal::atomic<int> state_;
+
+ private:
+  once_flag(const once_flag& other);
+  void operator=(const once_flag& other);
+};
+
+namespace internal {
+
+struct once_access {
+  static bool begin(once_flag& flag) {
+    return flag.begin();
+  }
+
+  static void finish(once_flag& flag) {
+    flag.finish();
+  }
+};
+
+}  /* namespace internal */
+
+/* Runs the function exactly once for the given flag. Concurrent callers
+ * block until it's finished, later callers only do an acquire load.
+ *
+ * Function object is constructed by the caller even when the flag is done
+ * already, use the function pointer overload or check once_flag::done()
+ * first in hot paths.
+ */
+inline void call_once(once_flag& flag,
+                      function::function<void(void)> function) {
+  if (flag.done()) {
+    return;
+  }
+  if (internal::once_access::begin(flag)) {
+    function();
+    internal::once_access::finish(flag);
+  }
+}
+
+inline void call_once(once_flag& flag, void (*function)(void)) {
+  if (flag.done()) {
+    return;
+  }
+  if (internal::once_access::begin(flag)) {
+    function();
+    internal::once_access::finish(flag);
+  }
+}
+
+}  /* namespace future */
+
+#endif  /* FUTURE_ONCE_H_ */
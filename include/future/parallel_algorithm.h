@@ -0,0 +1,322 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_PARALLEL_ALGORITHM_H_
+#define FUTURE_PARALLEL_ALGORITHM_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "future/parallel_foreach.h"
+#include "future/thread_pool.h"
+
+namespace future {
+namespace internal {
+
+/* Part of a merge of two sorted ranges which produces outputs
+ * [begin, end) of the merged sequence. Chunks are independent, so all of
+ * them could be run in parallel.
+ */
+template <typename Iterator1, typename Iterator2, typename OutputIterator>
+struct merge_chunk {
+  merge_chunk(Iterator1 first1, ptrdiff_t size1,
+              Iterator2 first2, ptrdiff_t size2,
+              OutputIterator result,
+              ptrdiff_t begin, ptrdiff_t end)
+      : first1(first1),
+        size1(size1),
+        first2(first2),
+        size2(size2),
+        result(result),
+        begin(begin),
+        end(end) {}
+
+  Iterator1 first1;
+  ptrdiff_t size1;
+  Iterator2 first2;
+  ptrdiff_t size2;
+  OutputIterator result;
+  ptrdiff_t begin;
+  ptrdiff_t end;
+};
+
+/* Number of elements taken from the first range among the first index
+ * elements of a stable merge (elements of the first range go first when
+ * equivalent). Binary search along the merge path.
+ */
+template <typename Iterator1, typename Iterator2, typename Compare>
+ptrdiff_t merge_path_split(Iterator1 first1, ptrdiff_t size1,
+                           Iterator2 first2, ptrdiff_t size2,
+                           ptrdiff_t index,
+                           Compare& compare) {
+  ptrdiff_t low = std::max(index - size2, (ptrdiff_t)0);
+  ptrdiff_t high = std::min(index, size1);
+  while (low < high) {
+    ptrdiff_t middle = low + (high - low) / 2;
+    if (compare(first2[index - middle - 1], first1[middle])) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return low;
+}
+
+template <typename Iterator1, typename Iterator2,
+          typename OutputIterator, typename Compare>
+class merge_chunk_function {
+ public:
+  typedef merge_chunk<Iterator1, Iterator2, OutputIterator> chunk_type;
+
+  explicit merge_chunk_function(Compare *compare) : compare_(compare) {}
+
+  void operator()(const chunk_type& chunk) const {
+    Compare& compare = *compare_;
+    ptrdiff_t begin1 = merge_path_split(chunk.first1, chunk.size1,
+                                        chunk.first2, chunk.size2,
+                                        chunk.begin, compare);
+    ptrdiff_t end1 = merge_path_split(chunk.first1, chunk.size1,
+                                      chunk.first2, chunk.size2,
+                                      chunk.end, compare);
+    std::merge(chunk.first1 + begin1, chunk.first1 + end1,
+               chunk.first2 + (chunk.begin - begin1),
+               chunk.first2 + (chunk.end - end1),
+               chunk.result + chunk.begin,
+               compare);
+  }
+
+ protected:
+  Compare *compare_;
+};
+
+/* Number of output elements merged by one task. */
+enum { merge_grain_size = 16384 };
+
+template <typename Iterator1, typename Iterator2, typename OutputIterator>
+void add_merge_chunks(
+    Iterator1 first1, ptrdiff_t size1,
+    Iterator2 first2, ptrdiff_t size2,
+    OutputIterator result,
+    std::vector<merge_chunk<Iterator1, Iterator2, OutputIterator> > *chunks) {
+  typedef merge_chunk<Iterator1, Iterator2, OutputIterator> chunk_type;
+  ptrdiff_t size = size1 + size2;
+  for (ptrdiff_t begin = 0; begin < size; begin += merge_grain_size) {
+    chunks->push_back(chunk_type(first1, size1, first2, size2, result,
+                                 begin,
+                                 std::min(begin + (ptrdiff_t)merge_grain_size,
+                                          size)));
+  }
+}
+
+template <typename Iterator, typename Compare>
+class sort_block_function {
+ public:
+  sort_block_function(Iterator first, Compare *compare)
+      : first_(first),
+        compare_(compare) {}
+
+  void operator()(const std::pair<ptrdiff_t, ptrdiff_t>& block) const {
+    std::sort(first_ + block.first, first_ + block.second, *compare_);
+  }
+
+ protected:
+  Iterator first_;
+  Compare *compare_;
+};
+
+/* Merge neighbour pairs of sorted runs from source to destination. Run
+ * without a pair is copied as-is, bounds are updated to the new runs.
+ */
+template <typename SourceIterator, typename DestinationIterator,
+          typename Compare>
+void merge_sort_pass(SourceIterator source,
+                     DestinationIterator destination,
+                     std::vector<ptrdiff_t> *bounds,
+                     Compare *compare,
+                     thread_pool *pool) {
+  typedef merge_chunk<SourceIterator, SourceIterator,
+                      DestinationIterator> chunk_type;
+  std::vector<chunk_type> chunks;
+  std::vector<ptrdiff_t> new_bounds;
+  size_t num_runs = bounds->size() - 1;
+  for (size_t i = 0; i < num_runs; i += 2) {
+    ptrdiff_t begin = (*bounds)[i];
+    ptrdiff_t middle = (*bounds)[i + 1];
+    ptrdiff_t end = i + 1 < num_runs ? (*bounds)[i + 2] : middle;
+    add_merge_chunks(source + begin, middle - begin,
+                     source + middle, end - middle,
+                     destination + begin,
+                     &chunks);
+    new_bounds.push_back(begin);
+  }
+  new_bounds.push_back(bounds->back());
+  parallel_for_each(
+      chunks,
+      merge_chunk_function<SourceIterator, SourceIterator,
+                           DestinationIterator, Compare>(compare),
+      pool);
+  bounds->swap(new_bounds);
+}
+
+template <typename SourceIterator, typename DestinationIterator>
+class copy_block_function {
+ public:
+  copy_block_function(SourceIterator source, DestinationIterator destination)
+      : source_(source),
+        destination_(destination) {}
+
+  void operator()(const std::pair<ptrdiff_t, ptrdiff_t>& block) const {
+    std::copy(source_ + block.first, source_ + block.second,
+              destination_ + block.first);
+  }
+
+ protected:
+  SourceIterator source_;
+  DestinationIterator destination_;
+};
+
+/* Plain element-wise copy, so it doesn't need any comparison of values. */
+template <typename SourceIterator, typename DestinationIterator>
+void parallel_copy(SourceIterator source,
+                   ptrdiff_t size,
+                   DestinationIterator destination,
+                   thread_pool *pool) {
+  typedef std::pair<ptrdiff_t, ptrdiff_t> block_type;
+  std::vector<block_type> blocks;
+  for (ptrdiff_t begin = 0; begin < size; begin += merge_grain_size) {
+    blocks.push_back(block_type(begin,
+                                std::min(begin + (ptrdiff_t)merge_grain_size,
+                                         size)));
+  }
+  parallel_for_each(
+      blocks,
+      copy_block_function<SourceIterator, DestinationIterator>(source,
+                                                               destination),
+      pool);
+}
+
+}  /* namespace internal */
+
+/* Merge two sorted ranges into result in parallel. Merge is stable,
+ * output is split along the merge path, so every task merges the same
+ * number of elements no matter how values are distributed.
+ */
+template <typename Iterator1, typename Iterator2,
+          typename OutputIterator, typename Compare>
+OutputIterator parallel_merge(Iterator1 first1, Iterator1 last1,
+                              Iterator2 first2, Iterator2 last2,
+                              OutputIterator result,
+                              Compare compare,
+                              thread_pool *pool = NULL) {
+  typedef internal::merge_chunk<Iterator1, Iterator2,
+                                OutputIterator> chunk_type;
+  std::vector<chunk_type> chunks;
+  internal::add_merge_chunks(first1, last1 - first1,
+                             first2, last2 - first2,
+                             result, &chunks);
+  parallel_for_each(
+      chunks,
+      internal::merge_chunk_function<Iterator1, Iterator2,
+                                     OutputIterator, Compare>(&compare),
+      pool);
+  return result + ((last1 - first1) + (last2 - first2));
+}
+
+template <typename Iterator1, typename Iterator2, typename OutputIterator>
+OutputIterator parallel_merge(Iterator1 first1, Iterator1 last1,
+                              Iterator2 first2, Iterator2 last2,
+                              OutputIterator result) {
+  typedef typename std::iterator_traits<Iterator1>::value_type T;
+  return parallel_merge(first1, last1, first2, last2, result,
+                        std::less<T>());
+}
+
+/* Parallel merge sort: blocks are sorted independently, then neighbour
+ * runs are merged pass by pass with parallel merges, ping-ponging between
+ * the range and a buffer of the same size, which is all the extra memory
+ * used.
+ *
+ * Comparator is any functor, including
+ * future::function::function<bool(T, T)>. Sort is not stable.
+ */
+template <typename Iterator, typename Compare>
+void parallel_sort(Iterator first,
+                   Iterator last,
+                   Compare compare,
+                   thread_pool *pool = NULL) {
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  typedef std::pair<ptrdiff_t, ptrdiff_t> block_type;
+  const ptrdiff_t min_block_size = 4096;
+  ptrdiff_t size = last - first;
+  if (pool == NULL) {
+    pool = &thread_pool::default_pool();
+  }
+  int num_threads = pool->num_threads();
+  if (num_threads <= 1 || size < 2 * min_block_size) {
+    std::sort(first, last, compare);
+    return;
+  }
+  /* Few blocks per thread to even out the load of the initial sort. */
+  ptrdiff_t num_blocks = std::min((ptrdiff_t)num_threads * 4,
+                                  size / min_block_size);
+  std::vector<block_type> blocks;
+  std::vector<ptrdiff_t> bounds;
+  for (ptrdiff_t i = 0; i < num_blocks; ++i) {
+    bounds.push_back(size * i / num_blocks);
+  }
+  bounds.push_back(size);
+  for (ptrdiff_t i = 0; i < num_blocks; ++i) {
+    blocks.push_back(block_type(bounds[i], bounds[i + 1]));
+  }
+  parallel_for_each(
+      blocks,
+      internal::sort_block_function<Iterator, Compare>(first, &compare),
+      pool);
+  std::vector<T> buffer(size);
+  bool in_buffer = false;
+  while (bounds.size() > 2) {
+    if (in_buffer) {
+      internal::merge_sort_pass(buffer.begin(), first,
+                                &bounds, &compare, pool);
+    } else {
+      internal::merge_sort_pass(first, buffer.begin(),
+                                &bounds, &compare, pool);
+    }
+    in_buffer = !in_buffer;
+  }
+  if (in_buffer) {
+    internal::parallel_copy(buffer.begin(), size, first, pool);
+  }
+}
+
+template <typename Iterator>
+void parallel_sort(Iterator first, Iterator last) {
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  parallel_sort(first, last, std::less<T>());
+}
+
+}  /* namespace future */
+
+#endif  /* FUTURE_PARALLEL_ALGORITHM_H_ */
@@ -0,0 +1,269 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_PARALLEL_FOREACH_H_
+#define FUTURE_PARALLEL_FOREACH_H_
+
+#include <cstddef>
+#include <algorithm>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/futex.h"
+#include "future/thread_pool.h"
+
+namespace future {
+namespace internal {
+
+/* Loop over a random access range, shared by the calling thread and
+ * helper tasks on the pool.
+ *
+ * Chunks are claimed with guided self-scheduling: every claim takes a
+ * share of the remaining iterations, so chunks are big at the beginning
+ * and get smaller towards the end, which balances the load without
+ * knowing cost of the iterations upfront.
+ *
+ * The loop is reference counted, since helper tasks might start after the
+ * loop is finished. Those only see there are no iterations left and never
+ * touch the function.
+ */
+template <typename Iterator, typename Function>
+class parallel_loop {
+ public:
+  parallel_loop(Iterator first,
+                ptrdiff_t size,
+                Function *function,
+                int num_threads)
+      : first_(first),
+        size_(size),
+        function_(function),
+        num_threads_(num_threads),
+        min_grain_(std::max(size / (num_threads * 32), (ptrdiff_t)1)),
+        next_(0),
+        num_done_(0),
+        status_(status_running),
+        num_references_(1) {}
+
+  inline void add_reference() {
+    num_references_.fetch_add(1, memory_order_relaxed);
+  }
+
+  inline void release() {
+    if (num_references_.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  /* Upper bound of the number of chunks, used to limit number of helpers. */
+  ptrdiff_t max_num_chunks() const {
+    return (size_ + min_grain_ - 1) / min_grain_;
+  }
+
+  /* Process chunks until there are no unclaimed iterations left. */
+  void process() {
+    ptrdiff_t begin, end;
+    while (claim(&begin, &end)) {
+      for (ptrdiff_t i = begin; i < end; ++i) {
+        (*function_)(first_[i]);
+      }
+      ptrdiff_t chunk_size = end - begin;
+      if (num_done_.fetch_add(chunk_size, memory_order_acq_rel) +
+          chunk_size == size_) {
+        if (status_.exchange(status_done, memory_order_acq_rel) ==
+            status_has_waiters) {
+          futex_wake_all(status_.address());
+        }
+      }
+    }
+  }
+
+  /* Entry point of helper tasks, releases reference of the helper. */
+  void run_helper() {
+    process();
+    release();
+  }
+
+  /* Wait for all the claimed chunks to be finished. */
+  void wait() {
+    for (;;) {
+      int status = status_.load(memory_order_acquire);
+      if (status == status_done) {
+        return;
+      }
+      if (status == status_running &&
+          !status_.compare_exchange_strong(status, status_has_waiters,
+                                           memory_order_acq_rel)) {
+        continue;
+      }
+      futex_wait(status_.address(), status_has_waiters);
+    }
+  }
+
+ protected:
+  enum {
+    status_running = 0,
+    status_has_waiters = 1,
+    status_done = 2
+  };
+
+  bool claim(ptrdiff_t *begin, ptrdiff_t *end) {
+    ptrdiff_t next = next_.load(memory_order_relaxed);
+    for (;;) {
+      ptrdiff_t num_remaining = size_ - next;
+      if (num_remaining <= 0) {
+        return false;
+      }
+      ptrdiff_t chunk_size = std::max(num_remaining / (2 * num_threads_),
+                                      min_grain_);
+      chunk_size = std::min(chunk_size, num_remaining);
+      if (next_.compare_exchange_weak(next, next + chunk_size,
+                                      memory_order_relaxed)) {
+        *begin = next;
+        *end = next + chunk_size;
+        return true;
+      }
+    }
+  }
+
+  Iterator first_;
+  ptrdiff_t size_;
+  Function *function_;
+  int num_threads_;
+  ptrdiff_t min_grain_;
+
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  atomic<ptrdiff_t> next_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  atomic<ptrdiff_t> num_done_;
+  atomic<int> status_;
+  atomic<int> num_references_;
+};
+
+template <typename Iterator, typename Function>
+void parallel_for_each_impl(Iterator first,
+                            Iterator last,
+                            Function function,
+                            thread_pool *pool) {
+  typedef parallel_loop<Iterator, Function> loop_type;
+  ptrdiff_t size = last - first;
+  if (size <= 0) {
+    return;
+  }
+  if (pool == NULL) {
+    pool = &thread_pool::default_pool();
+  }
+  int num_threads = pool->num_threads();
+  if (size == 1 || num_threads <= 1) {
+    for (; first != last; ++first) {
+      function(*first);
+    }
+    return;
+  }
+  loop_type *loop = new loop_type(first, size, &function, num_threads);
+  ptrdiff_t num_helpers = std::min((ptrdiff_t)num_threads,
+                                   loop->max_num_chunks() - 1);
+  for (ptrdiff_t i = 0; i < num_helpers; ++i) {
+    loop->add_reference();
+    pool->submit(::future::bind::function_bind(&loop_type::run_helper, loop));
+  }
+  /* Calling thread takes part in the loop, so nested loops issued from the
+   * pool workers can't starve waiting for each other.
+   */
+  loop->process();
+  loop->wait();
+  loop->release();
+}
+
+/* Proxy which makes it possible to pass a lambda after the macro. */
+template <typename Range>
+class parallel_foreach_range {
+ public:
+  explicit parallel_foreach_range(Range& range) : range_(range) {}
+
+  template <typename Function>
+  void operator->*(Function function) {
+    parallel_for_each_impl(range_.begin(), range_.end(), function, NULL);
+  }
+
+ protected:
+  Range& range_;
+};
+
+template <typename Range>
+parallel_foreach_range<Range> make_parallel_foreach_range(Range& range) {
+  return parallel_foreach_range<Range>(range);
+}
+
+template <typename Range>
+parallel_foreach_range<const Range> make_parallel_foreach_range(
+    const Range& range) {
+  return parallel_foreach_range<const Range>(range);
+}
+
+}  /* namespace internal */
+
+/* Invoke function for every element of the random access range, spreading
+ * work across the pool (default one if not specified). Function is called
+ * concurrently from multiple threads, elements are visited in no specific
+ * order. Returns once all the elements are processed.
+ */
+template <typename Iterator, typename Function>
+void parallel_for_each(Iterator first,
+                       Iterator last,
+                       Function function,
+                       thread_pool *pool = NULL) {
+  internal::parallel_for_each_impl(first, last, function, pool);
+}
+
+template <typename Range, typename Function>
+void parallel_for_each(Range& range,
+                       Function function,
+                       thread_pool *pool = NULL) {
+  internal::parallel_for_each_impl(range.begin(), range.end(),
+                                   function, pool);
+}
+
+template <typename Range, typename Function>
+void parallel_for_each(const Range& range,
+                       Function function,
+                       thread_pool *pool = NULL) {
+  internal::parallel_for_each_impl(range.begin(), range.end(),
+                                   function, pool);
+}
+
+/* Parallel counterpart of FUTURE_FOREACH. Body is captured into a lambda,
+ * so this is only available with C++11 compilers and the body is to be
+ * followed by a semicolon:
+ *
+ *   FUTURE_PARALLEL_FOREACH(int& value, values) {
+ *     value *= 2;
+ *   };
+ */
+#if __cplusplus >= 201103L
+#  define FUTURE_PARALLEL_FOREACH(var, range) \
+  ::future::internal::make_parallel_foreach_range(range) ->* [&](var)
+#endif
+
+}  /* namespace future */
+
+#endif  /* FUTURE_PARALLEL_FOREACH_H_ */
@@ -0,0 +1,239 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_PARALLEL_NUMERIC_H_
+#define FUTURE_PARALLEL_NUMERIC_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "future/parallel_foreach.h"
+#include "future/thread_pool.h"
+
+namespace future {
+namespace internal {
+
+/* Ranges are split into blocks whose size only depends on the size of the
+ * range, and per-block results are combined in a fixed order. This way the
+ * result is bit-exact for any number of threads, which matters for the
+ * floating point math.
+ */
+inline ptrdiff_t deterministic_block_size(ptrdiff_t size) {
+  const ptrdiff_t min_block_size = 1024;
+  const ptrdiff_t max_num_blocks = 4096;
+  return std::max(min_block_size,
+                  (size + max_num_blocks - 1) / max_num_blocks);
+}
+
+template <typename T>
+struct numeric_block {
+  numeric_block(ptrdiff_t begin, ptrdiff_t end, const T& value)
+      : begin(begin),
+        end(end),
+        value(value) {}
+
+  ptrdiff_t begin;
+  ptrdiff_t end;
+  T value;
+};
+
+template <typename T>
+void make_numeric_blocks(ptrdiff_t size,
+                         const T& initial_value,
+                         std::vector<numeric_block<T> > *blocks) {
+  ptrdiff_t block_size = deterministic_block_size(size);
+  blocks->reserve((size + block_size - 1) / block_size);
+  for (ptrdiff_t begin = 0; begin < size; begin += block_size) {
+    blocks->push_back(numeric_block<T>(begin,
+                                       std::min(begin + block_size, size),
+                                       initial_value));
+  }
+}
+
+/* Left fold of the mapped values of the block, starting from identity. */
+template <typename Iterator, typename T, typename Map, typename Combine>
+class reduce_block_function {
+ public:
+  reduce_block_function(Iterator first, Map *map, Combine *combine)
+      : first_(first),
+        map_(map),
+        combine_(combine) {}
+
+  void operator()(numeric_block<T>& block) const {
+    T value = block.value;
+    for (ptrdiff_t i = block.begin; i < block.end; ++i) {
+      value = (*combine_)(value, (*map_)(first_[i]));
+    }
+    block.value = value;
+  }
+
+ protected:
+  Iterator first_;
+  Map *map_;
+  Combine *combine_;
+};
+
+/* Left fold of the values of the block, starting from the first one. */
+template <typename Iterator, typename T, typename Combine>
+class scan_sum_block_function {
+ public:
+  scan_sum_block_function(Iterator first, Combine *combine)
+      : first_(first),
+        combine_(combine) {}
+
+  void operator()(numeric_block<T>& block) const {
+    T value = first_[block.begin];
+    for (ptrdiff_t i = block.begin + 1; i < block.end; ++i) {
+      value = (*combine_)(value, first_[i]);
+    }
+    block.value = value;
+  }
+
+ protected:
+  Iterator first_;
+  Combine *combine_;
+};
+
+/* Block value is the combination of all the preceding blocks here. */
+template <typename Iterator, typename OutputIterator,
+          typename T, typename Combine>
+class scan_block_function {
+ public:
+  scan_block_function(Iterator first,
+                      OutputIterator result,
+                      Combine *combine)
+      : first_(first),
+        result_(result),
+        combine_(combine) {}
+
+  void operator()(numeric_block<T>& block) const {
+    ptrdiff_t i = block.begin;
+    T value = i == 0 ? T(first_[i]) : (*combine_)(block.value, first_[i]);
+    result_[i] = value;
+    for (++i; i < block.end; ++i) {
+      value = (*combine_)(value, first_[i]);
+      result_[i] = value;
+    }
+  }
+
+ protected:
+  Iterator first_;
+  OutputIterator result_;
+  Combine *combine_;
+};
+
+}  /* namespace internal */
+
+/* Reduce mapped values of the range in parallel:
+ *
+ *   combine(...combine(combine(identity, map(x0)), map(x1))..., map(xn))
+ *
+ * combine is expected to be associative, identity is to be its neutral
+ * element. Values are combined along a fixed tree, so the result is the
+ * same from run to run regardless of the number of threads (but might be
+ * different from a sequential loop for non-exact types like floats).
+ *
+ * Map and combine could be functors or future::function::function.
+ */
+template <typename Iterator, typename T, typename Map, typename Combine>
+T parallel_reduce(Iterator first,
+                  Iterator last,
+                  const T& identity,
+                  Map map,
+                  Combine combine,
+                  thread_pool *pool = NULL) {
+  typedef internal::numeric_block<T> block_type;
+  std::vector<block_type> blocks;
+  internal::make_numeric_blocks(last - first, identity, &blocks);
+  if (blocks.empty()) {
+    return identity;
+  }
+  parallel_for_each(
+      blocks,
+      internal::reduce_block_function<Iterator, T, Map, Combine>(
+          first, &map, &combine),
+      pool);
+  /* Balanced pairwise tree over the blocks. */
+  std::vector<T> values;
+  values.reserve(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    values.push_back(blocks[i].value);
+  }
+  size_t num_values = values.size();
+  while (num_values > 1) {
+    size_t num_pairs = num_values / 2;
+    for (size_t i = 0; i < num_pairs; ++i) {
+      values[i] = combine(values[2 * i], values[2 * i + 1]);
+    }
+    if (num_values % 2 != 0) {
+      values[num_pairs] = values[num_values - 1];
+    }
+    num_values = num_pairs + num_values % 2;
+  }
+  return values[0];
+}
+
+/* Inclusive prefix scan: result[i] = combine(...combine(x0, x1)..., xi).
+ * Works in-place when result is the same as first.
+ *
+ * Same as in parallel_reduce() combine is expected to be associative and
+ * the result is reproducible regardless of the number of threads.
+ */
+template <typename Iterator, typename OutputIterator, typename Combine>
+OutputIterator parallel_inclusive_scan(Iterator first,
+                                       Iterator last,
+                                       OutputIterator result,
+                                       Combine combine,
+                                       thread_pool *pool = NULL) {
+  typedef typename std::iterator_traits<Iterator>::value_type T;
+  typedef internal::numeric_block<T> block_type;
+  ptrdiff_t size = last - first;
+  if (size <= 0) {
+    return result;
+  }
+  std::vector<block_type> blocks;
+  internal::make_numeric_blocks(size, T(*first), &blocks);
+  parallel_for_each(
+      blocks,
+      internal::scan_sum_block_function<Iterator, T, Combine>(first,
+                                                              &combine),
+      pool);
+  /* Turn block sums into combination of all the preceding blocks. */
+  T prefix = blocks[0].value;
+  for (size_t i = 1; i < blocks.size(); ++i) {
+    T block_sum = blocks[i].value;
+    blocks[i].value = prefix;
+    prefix = combine(prefix, block_sum);
+  }
+  parallel_for_each(
+      blocks,
+      internal::scan_block_function<Iterator, OutputIterator, T, Combine>(
+          first, result, &combine),
+      pool);
+  return result + size;
+}
+
+}  /* namespace future */
+
+#endif  /* FUTURE_PARALLEL_NUMERIC_H_ */
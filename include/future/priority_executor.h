@@ -0,0 +1,352 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_PRIORITY_EXECUTOR_H_
+#define FUTURE_PRIORITY_EXECUTOR_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/clock.h"
+#include "future/executor.h"
+#include "future/futex.h"
+#include "future/mpmc_queue.h"
+#include "future/mutex.h"
+#include "future/thread.h"
+
+namespace future {
+
+/* Executor with its own worker threads which runs tasks according to their
+ * priority, zero being the highest one.
+ *
+ * Every priority has its own lane: a lock-free bounded queue, with a
+ * mutex protected overflow list used only once the queue is full. Workers
+ * pick lanes according to the policy:
+ *
+ *  - Strict: always the highest priority lane which has tasks.
+ *  - Weighted: lanes are visited in proportion to their weights, by
+ *    default every priority gets twice the share of the next one.
+ *
+ * With aging enabled a lane which has tasks but was not served for longer
+ * than the aging period is served first regardless of the policy, so low
+ * priority tasks never starve.
+ */
+class priority_executor : public executor {
+ public:
+  enum dequeue_policy {
+    policy_strict,
+    policy_weighted
+  };
+
+  /* Zero number of threads means one thread per online CPU, zero aging
+   * period disables aging.
+   */
+  explicit priority_executor(int num_priorities = 3,
+                             int num_threads = 0,
+                             dequeue_policy policy = policy_weighted,
+                             uint64_t aging_ms = 100)
+      : policy_(policy),
+        aging_ns_(aging_ms * 1000000ULL),
+        num_started_(0),
+        total_weight_(0),
+        ticket_(0),
+        wake_epoch_(0),
+        num_sleepers_(0),
+        stopping_(0) {
+    assert(num_priorities > 0);
+    if (num_threads <= 0) {
+      num_threads = thread::hardware_concurrency();
+    }
+    lanes_.resize(num_priorities);
+    for (int i = 0; i < num_priorities; ++i) {
+      lanes_[i] = new lane();
+      int weight = 1 << std::min(num_priorities - 1 - i, 16);
+      lanes_[i]->weight.store(weight, internal::memory_order_relaxed);
+      total_weight_.fetch_add(weight, internal::memory_order_relaxed);
+    }
+    workers_.resize(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      workers_[i] = new thread(::future::bind::function_bind(
+          &priority_executor::worker_main, this, i));
+      if (workers_[i]->joinable()) {
+        ++num_started_;
+      }
+    }
+  }
+
+  /* Finishes all the submitted tasks before returning. */
+  ~priority_executor() {
+    stopping_.store(1);
+    wake_epoch_.fetch_add(1);
+    internal::futex_wake_all(wake_epoch_.address());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      if (workers_[i]->joinable()) {
+        workers_[i]->join();
+      }
+      delete workers_[i];
+    }
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+      delete lanes_[i];
+    }
+  }
+
+  using executor::submit;
+
+  /* Tasks submitted without priority get the lowest one. */
+  void submit(task_type task) {
+    submit(task, num_priorities() - 1);
+  }
+
+  void submit(task_type task, int priority) {
+    assert(priority >= 0 && priority < num_priorities());
+    /* No thread could be started, nobody would ever run queued tasks. */
+    if (num_started_ == 0) {
+      task();
+      return;
+    }
+    lanes_[priority]->push(new task_type(task));
+    wake_one();
+  }
+
+  int num_priorities() const {
+    return (int)lanes_.size();
+  }
+
+  /* Number of workers which actually started. */
+  int num_threads() const {
+    return num_started_;
+  }
+
+  /* Share of the lane for the weighted policy. Could be changed at any
+   * time, workers pick the new shares up shortly.
+   */
+  void set_weight(int priority, int weight) {
+    assert(priority >= 0 && priority < num_priorities());
+    assert(weight > 0);
+    int old_weight = lanes_[priority]->weight.exchange(weight);
+    total_weight_.fetch_add(weight - old_weight);
+  }
+
+ protected:
+  typedef mpmc_queue<task_type*> queue_type;
+
+  enum {
+    lane_capacity = 4096,
+    num_spins_before_park = 64
+  };
+
+  struct lane {
+    lane()
+        : queue(lane_capacity),
+          overflow_mutex("priority_executor_overflow"),
+          num_overflow(0),
+          size(0),
+          last_service_ns(0),
+          weight(0) {}
+
+    void push(task_type *task) {
+      /* Lane which just became non-empty has not been waiting. */
+      if (size.fetch_add(1) == 0) {
+        last_service_ns.store(internal::monotonic_time_ns(),
+                              internal::memory_order_relaxed);
+      }
+      if (num_overflow.load(internal::memory_order_relaxed) == 0 &&
+          queue.try_push(task)) {
+        return;
+      }
+      mutex::scoped_lock lock(overflow_mutex);
+      overflow.push_back(task);
+      num_overflow.fetch_add(1, internal::memory_order_relaxed);
+    }
+
+    task_type *pop(uint64_t now_ns) {
+      if (size.load(internal::memory_order_relaxed) == 0) {
+        return NULL;
+      }
+      task_type *task = NULL;
+      if (!queue.try_pop(&task) &&
+          num_overflow.load(internal::memory_order_relaxed) != 0) {
+        mutex::scoped_lock lock(overflow_mutex);
+        if (!overflow.empty()) {
+          task = overflow.front();
+          overflow.pop_front();
+          num_overflow.fetch_sub(1, internal::memory_order_relaxed);
+        }
+      }
+      if (task != NULL) {
+        size.fetch_sub(1, internal::memory_order_relaxed);
+        last_service_ns.store(now_ns, internal::memory_order_relaxed);
+      }
+      return task;
+    }
+
+    queue_type queue;
+    mutex overflow_mutex;
+    std::deque<task_type*> overflow;
+    internal::atomic<int> num_overflow;
+    /* Number of tasks, including the ones being pushed right now. */
+    internal::atomic<int> size;
+    internal::atomic<uint64_t> last_service_ns;
+    internal::atomic<int> weight;
+  };
+
+  /* Lane which owns the given ticket. Weights might be changing meanwhile:
+   * concurrent set_weight() calls on the same lane could even leave the
+   * total at zero or below for a moment. Last lane is used whenever the
+   * weights do not add up.
+   */
+  int lane_for_ticket(uint32_t ticket) const {
+    int last_lane = (int)lanes_.size() - 1;
+    int total_weight = total_weight_.load(internal::memory_order_relaxed);
+    if (total_weight <= 0) {
+      return last_lane;
+    }
+    int remaining = (int)(ticket % (uint32_t)total_weight);
+    for (int i = 0; i < last_lane; ++i) {
+      remaining -= lanes_[i]->weight.load(internal::memory_order_relaxed);
+      if (remaining < 0) {
+        return i;
+      }
+    }
+    return last_lane;
+  }
+
+  void worker_main(int index) {
+    char name[16];
+    snprintf(name, sizeof(name), "future-prio-%d", index);
+    thread::set_current_name(name);
+    using internal::memory_order_acquire;
+    int num_spins = 0;
+    for (;;) {
+      task_type *task = find_task();
+      if (task != NULL) {
+        run_task(task);
+        num_spins = 0;
+        continue;
+      }
+      if (stopping_.load(memory_order_acquire)) {
+        break;
+      }
+      if (num_spins < num_spins_before_park) {
+        ++num_spins;
+        internal::cpu_relax();
+        continue;
+      }
+      int epoch = wake_epoch_.load(memory_order_acquire);
+      num_sleepers_.fetch_add(1);
+      task = find_task();
+      if (task == NULL && !stopping_.load()) {
+        internal::futex_wait(wake_epoch_.address(), epoch);
+      }
+      num_sleepers_.fetch_sub(1);
+      if (task != NULL) {
+        run_task(task);
+      }
+      num_spins = 0;
+    }
+  }
+
+  task_type *find_task() {
+    uint64_t now_ns = 0;
+    int num_lanes = (int)lanes_.size();
+    if (aging_ns_ != 0) {
+      now_ns = internal::monotonic_time_ns();
+      /* Serve the lane which waits the longest past the aging period. */
+      int starving = -1;
+      uint64_t longest_wait = aging_ns_;
+      for (int i = 0; i < num_lanes; ++i) {
+        lane *current = lanes_[i];
+        if (current->size.load(internal::memory_order_relaxed) == 0) {
+          continue;
+        }
+        uint64_t last_service_ns =
+            current->last_service_ns.load(internal::memory_order_relaxed);
+        if (now_ns > last_service_ns &&
+            now_ns - last_service_ns > longest_wait) {
+          longest_wait = now_ns - last_service_ns;
+          starving = i;
+        }
+      }
+      if (starving != -1) {
+        task_type *task = lanes_[starving]->pop(now_ns);
+        if (task != NULL) {
+          return task;
+        }
+      }
+    }
+    if (policy_ == policy_weighted) {
+      uint32_t ticket = ticket_.fetch_add(1, internal::memory_order_relaxed);
+      int preferred = lane_for_ticket(ticket);
+      task_type *task = lanes_[preferred]->pop(now_ns);
+      if (task != NULL) {
+        return task;
+      }
+    }
+    for (int i = 0; i < num_lanes; ++i) {
+      task_type *task = lanes_[i]->pop(now_ns);
+      if (task != NULL) {
+        return task;
+      }
+    }
+    return NULL;
+  }
+
+  static void run_task(task_type *task) {
+    (*task)();
+    delete task;
+  }
+
+  void wake_one() {
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    if (num_sleepers_.load(internal::memory_order_relaxed) != 0) {
+      wake_epoch_.fetch_add(1);
+      internal::futex_wake(wake_epoch_.address(), 1);
+    }
+  }
+
+  dequeue_policy policy_;
+  uint64_t aging_ns_;
+  std::vector<lane*> lanes_;
+  std::vector<thread*> workers_;
+  /* Written by the constructor only. */
+  int num_started_;
+  /* Sum of the lane weights, changes rarely. */
+  internal::atomic<int> total_weight_;
+
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<uint32_t> ticket_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<int> wake_epoch_;
+  internal::atomic<int> num_sleepers_;
+  internal::atomic<int> stopping_;
+  char pad2_[FUTURE_CACHELINE_SIZE];
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_PRIORITY_EXECUTOR_H_ */
@@ -0,0 +1,317 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_RCU_H_
+#define FUTURE_RCU_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <sched.h>
+#  include <unistd.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <stdint.h>
+#include <cassert>
+
+#include "future/atomic.h"
+#include "future/thread_specific.h"
+
+namespace future {
+
+class rcu_domain;
+
+namespace internal {
+
+/* Per-thread state of a domain. Records are never freed while the domain
+ * is alive, records of exited threads are reused by new threads.
+ */
+struct rcu_record {
+  explicit rcu_record(::future::rcu_domain *domain)
+      : domain(domain),
+        counter(0),
+        in_use(1),
+        nesting(0),
+        next(NULL) {}
+
+  ::future::rcu_domain *domain;
+  /* Grace period counter observed when the thread entered a read-side
+   * critical section, zero while the thread is quiescent.
+   */
+  atomic<uint64_t> counter;
+  atomic<int> in_use;
+  int nesting;
+  rcu_record *next;
+  char pad_[FUTURE_CACHELINE_SIZE];
+};
+
+inline void rcu_record_release(rcu_record *record);
+
+}  /* namespace internal */
+
+/* Read-copy-update domain.
+ *
+ * Readers announce a read-side critical section by copying the global grace
+ * period counter into their own record, which only touches the cache line
+ * of the calling thread. Writer starts a grace period by bumping the global
+ * counter and waits until every record is either quiescent or has observed
+ * the new value, after which no reader can hold a pointer unpublished
+ * before the grace period started.
+ *
+ * Counter only grows, so a reader which observed a value at least as new as
+ * the one synchronize() installed entered after the grace period started
+ * and can't hold anything retired by it.
+ *
+ * Lifetime rules are the same as for the epoch domain.
+ */
+class rcu_domain {
+ public:
+  rcu_domain()
+      : global_counter_(1),
+        records_(NULL),
+        record_(internal::rcu_record_release) {}
+
+  /* No thread is to be inside a critical section of the domain. */
+  ~rcu_domain() {
+    /* Records are freed here, not by the thread exit cleanup. */
+    record_.release();
+    internal::rcu_record *record = records_.load();
+    while (record != NULL) {
+      internal::rcu_record *next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+
+  /* Read-side critical sections can be nested. */
+  void enter() {
+    internal::rcu_record *record = current_record();
+    if (record->nesting++ == 0) {
+      record->counter.store(
+          global_counter_.load(internal::memory_order_relaxed),
+          internal::memory_order_relaxed);
+      /* Announcement is to be visible before any shared pointer is read. */
+      internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    }
+  }
+
+  void exit() {
+    internal::rcu_record *record = current_record();
+    assert(record->nesting > 0);
+    if (--record->nesting == 0) {
+      record->counter.store(0, internal::memory_order_release);
+    }
+  }
+
+  /* Waits for all the read-side critical sections which started before the
+   * call to finish. Must not be called from inside a critical section.
+   */
+  void synchronize() {
+    assert(record_.get() == NULL || record_.get()->nesting == 0);
+    uint64_t counter = global_counter_.fetch_add(1) + 1;
+    /* Pairs with the fence in enter(): either the reader sees the new
+     * pointer or we see its announcement. Records are loaded with acquire
+     * only, which alone doesn't order them after the pointer exchange.
+     */
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    for (internal::rcu_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      int num_attempts = 0;
+      for (;;) {
+        uint64_t observed = record->counter.load(
+            internal::memory_order_acquire);
+        if (observed == 0 || observed >= counter) {
+          break;
+        }
+        backoff(num_attempts++);
+      }
+    }
+  }
+
+  /* Domain shared by rcu_ptr unless told otherwise. Every synchronize()
+   * waits for readers of all the pointers in it, so pointers updated often
+   * are better off with a domain of their own.
+   */
+  static rcu_domain& default_domain() {
+    static rcu_domain *domain = new rcu_domain();
+    return *domain;
+  }
+
+ protected:
+  friend void internal::rcu_record_release(internal::rcu_record *record);
+
+  enum { max_spin_attempts = 1024, max_yield_attempts = 1088 };
+
+  /* Read sections are expected to be short, so spin first, but a preempted
+   * reader can take a while.
+   */
+  static void backoff(int num_attempts) {
+    if (num_attempts < max_spin_attempts) {
+      internal::cpu_relax();
+    } else if (num_attempts < max_yield_attempts) {
+      sched_yield();
+    } else {
+      usleep(1000);
+    }
+  }
+
+  internal::rcu_record *current_record() {
+    internal::rcu_record *record = record_.get();
+    if (record == NULL) {
+      record = acquire_record();
+      record_.reset(record);
+    }
+    return record;
+  }
+
+  internal::rcu_record *acquire_record() {
+    for (internal::rcu_record *record = records_.load();
+         record != NULL;
+         record = record->next) {
+      int in_use = 0;
+      if (record->in_use.load(internal::memory_order_relaxed) == 0 &&
+          record->in_use.compare_exchange_strong(in_use, 1)) {
+        return record;
+      }
+    }
+    internal::rcu_record *record = new internal::rcu_record(this);
+    internal::rcu_record *head = records_.load();
+    do {
+      record->next = head;
+    } while (!records_.compare_exchange_weak(head, record));
+    return record;
+  }
+
+  /* Record of an exited thread is quiescent, its counter is zero, so it's
+   * simply handed to the next thread which enters the domain.
+   */
+  void release_record(internal::rcu_record *record) {
+    assert(record->nesting == 0);
+    record->in_use.store(0, internal::memory_order_release);
+  }
+
+  internal::atomic<uint64_t> global_counter_;
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<internal::rcu_record*> records_;
+
+  thread_specific_ptr<internal::rcu_record> record_;
+
+ private:
+  rcu_domain(const rcu_domain& other);
+  void operator=(const rcu_domain& other);
+};
+
+/* Pointer to an immutable object which is read often and replaced rarely.
+ *
+ * Readers take a snapshot which costs a store to a thread-local record and
+ * a fence, no shared memory is written. Writers publish a new version with
+ * an atomic exchange, the old version is deleted once a grace period has
+ * passed.
+ */
+template <typename T>
+class rcu_ptr {
+ public:
+  /* Read-side critical section, the object stays alive while it exists. */
+  class snapshot {
+   public:
+    explicit snapshot(const rcu_ptr& ptr)
+        : domain_(ptr.domain_) {
+      domain_.enter();
+      pointer_ = ptr.pointer_.load(internal::memory_order_acquire);
+    }
+
+    ~snapshot() {
+      domain_.exit();
+    }
+
+    const T *get() const {
+      return pointer_;
+    }
+
+    const T *operator->() const {
+      assert(pointer_ != NULL);
+      return pointer_;
+    }
+
+    const T& operator*() const {
+      assert(pointer_ != NULL);
+      return *pointer_;
+    }
+
+   protected:
+    rcu_domain& domain_;
+    const T *pointer_;
+
+   private:
+    snapshot(const snapshot& other);
+    void operator=(const snapshot& other);
+  };
+
+  explicit rcu_ptr(T *pointer = NULL,
+                   rcu_domain& domain = rcu_domain::default_domain())
+      : domain_(domain),
+        pointer_(pointer) {}
+
+  /* No snapshot is to be alive. */
+  ~rcu_ptr() {
+    delete pointer_.load();
+  }
+
+  /* Publishes the new version and deletes the old one after a grace
+   * period, blocking the caller until then.
+   */
+  void update(T *pointer) {
+    delete exchange(pointer);
+  }
+
+  /* Publishes the new version and returns the old one once no reader can
+   * access it any more.
+   */
+  T *exchange(T *pointer) {
+    T *old_pointer = pointer_.exchange(pointer);
+    if (old_pointer != NULL) {
+      domain_.synchronize();
+    }
+    return old_pointer;
+  }
+
+ protected:
+  rcu_domain& domain_;
+  internal::atomic<T*> pointer_;
+
+ private:
+  rcu_ptr(const rcu_ptr& other);
+  void operator=(const rcu_ptr& other);
+};
+
+namespace internal {
+
+inline void rcu_record_release(rcu_record *record) {
+  record->domain->release_record(record);
+}
+
+}  /* namespace internal */
+
+}  /* namespace future */
+
+#endif  /* FUTURE_RCU_H_ */
@@ -0,0 +1,141 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_SEMAPHORE_H_
+#define FUTURE_SEMAPHORE_H_
+
+#include <stdint.h>
+#include <cassert>
+
+#include "future/atomic.h"
+#include "future/clock.h"
+#include "future/futex.h"
+
+namespace future {
+
+/* Semaphore with a non-negative counter of available permits.
+ *
+ * Acquiring and releasing are atomic operations on the counter, threads only
+ * sleep on a futex when there are no permits available, and releasing only
+ * issues a wake up if there are sleeping threads.
+ */
+class counting_semaphore {
+ public:
+  explicit counting_semaphore(int count)
+      : count_(count),
+        num_sleepers_(0) {
+    assert(count >= 0);
+  }
+
+  bool try_acquire() {
+    int count = count_.load(internal::memory_order_relaxed);
+    while (count > 0) {
+      if (count_.compare_exchange_weak(count, count - 1,
+                                       internal::memory_order_acquire)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void acquire() {
+    if (spin_acquire()) {
+      return;
+    }
+    for (;;) {
+      num_sleepers_.fetch_add(1);
+      bool acquired = try_acquire();
+      if (!acquired) {
+        internal::futex_wait(count_.address(), 0);
+      }
+      num_sleepers_.fetch_sub(1);
+      if (acquired || try_acquire()) {
+        return;
+      }
+    }
+  }
+
+  /* Returns false if no permit became available in time. */
+  bool try_acquire_for(uint64_t timeout_ms) {
+    if (spin_acquire()) {
+      return true;
+    }
+    uint64_t deadline =
+        internal::monotonic_time_ns() + timeout_ms * 1000000ULL;
+    for (;;) {
+      uint64_t now = internal::monotonic_time_ns();
+      if (now >= deadline) {
+        return false;
+      }
+      num_sleepers_.fetch_add(1);
+      bool acquired = try_acquire();
+      if (!acquired) {
+        internal::futex_wait_for(count_.address(), 0, deadline - now);
+      }
+      num_sleepers_.fetch_sub(1);
+      if (acquired || try_acquire()) {
+        return true;
+      }
+    }
+  }
+
+  void release(int n = 1) {
+    assert(n >= 0);
+    count_.fetch_add(n);
+    /* Sleepers announce themselves before re-checking the counter, so
+     * either they see the permits or we see them here.
+     */
+    if (num_sleepers_.load() != 0) {
+      internal::futex_wake(count_.address(), n);
+    }
+  }
+
+  /* Number of permits at the moment of the call, for diagnostics. */
+  int available() const {
+    return count_.load(internal::memory_order_relaxed);
+  }
+
+ protected:
+  enum { num_spins = 128 };
+
+  bool spin_acquire() {
+    for (int i = 0; i < num_spins; ++i) {
+      if (try_acquire()) {
+        return true;
+      }
+      internal::cpu_relax();
+    }
+    return false;
+  }
+
+  /* Counter is the futex word, sleepers wait for it to leave zero. */
+  internal::atomic<int> count_;
+  internal::atomic<int> num_sleepers_;
+
+ private:
+  counting_semaphore(const counting_semaphore& other);
+  void operator=(const counting_semaphore& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_SEMAPHORE_H_ */
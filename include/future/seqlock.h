@@ -0,0 +1,186 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_SEQLOCK_H_
+#define FUTURE_SEQLOCK_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <sched.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <cstring>
+
+#include "future/atomic.h"
+
+namespace future {
+
+/* Sequence lock for small read-mostly values of trivially copyable type T.
+ *
+ * Writer makes the sequence odd, updates the value and makes the sequence
+ * even again. Readers copy the value optimistically and retry if the
+ * sequence was odd or changed meanwhile, so they never write to shared
+ * memory and don't bounce the cache line between each other. Writers are
+ * serialized with each other by spinning on the sequence, so writes are
+ * to be short and rare.
+ *
+ * Value is kept as an array of words accessed with relaxed atomics, so
+ * torn reads which are discarded by the retry are not data races.
+ */
+template <typename T>
+class seqlock {
+ public:
+  /* Scoped read-modify-write access. Readers spin until it's destroyed, so
+   * keep the scope tiny.
+   */
+  class writer {
+   public:
+    explicit writer(seqlock& lock)
+        : lock_(lock) {
+      lock_.write_lock();
+      lock_.copy_out(&value_);
+    }
+
+    ~writer() {
+      lock_.copy_in(value_);
+      lock_.write_unlock();
+    }
+
+    T& value() {
+      return value_;
+    }
+
+    T *operator->() {
+      return &value_;
+    }
+
+   protected:
+    seqlock& lock_;
+    T value_;
+
+   private:
+    writer(const writer& other);
+    void operator=(const writer& other);
+  };
+
+  seqlock() : sequence_(0) {
+    copy_in(T());
+  }
+
+  explicit seqlock(const T& value) : sequence_(0) {
+    copy_in(value);
+  }
+
+  T load() const {
+    T value;
+    int num_attempts = 0;
+    while (!try_load(&value)) {
+      if (++num_attempts < max_spin_attempts) {
+        internal::cpu_relax();
+      } else {
+        /* Writer might have been preempted. */
+        sched_yield();
+      }
+    }
+    return value;
+  }
+
+  /* Single optimistic read attempt, false if it raced with a writer. */
+  bool try_load(T *value) const {
+    unsigned int sequence = sequence_.load(internal::memory_order_acquire);
+    if (sequence & 1) {
+      return false;
+    }
+    copy_out(value);
+    internal::atomic_thread_fence(internal::memory_order_acquire);
+    return sequence_.load(internal::memory_order_relaxed) == sequence;
+  }
+
+  void store(const T& value) {
+    write_lock();
+    copy_in(value);
+    write_unlock();
+  }
+
+  /* Even number which changes with every write, can be used by readers to
+   * cheaply check whether the value changed since their last read.
+   */
+  unsigned int sequence() const {
+    return sequence_.load(internal::memory_order_acquire) & ~1U;
+  }
+
+ protected:
+  typedef unsigned long word;
+
+  enum { num_words = (sizeof(T) + sizeof(word) - 1) / sizeof(word) };
+  enum { max_spin_attempts = 1024 };
+
+  void write_lock() {
+    unsigned int sequence = sequence_.load(internal::memory_order_relaxed);
+    for (;;) {
+      if ((sequence & 1) == 0 &&
+          sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                          internal::memory_order_acquire)) {
+        break;
+      }
+      internal::cpu_relax();
+      sequence = sequence_.load(internal::memory_order_relaxed);
+    }
+    /* Sequence must become odd before any of the words change. */
+    internal::atomic_thread_fence(internal::memory_order_release);
+  }
+
+  void write_unlock() {
+    sequence_.fetch_add(1, internal::memory_order_release);
+  }
+
+  void copy_in(const T& value) {
+    word words[num_words] = {0};
+    memcpy(words, &value, sizeof(T));
+    for (int i = 0; i < num_words; ++i) {
+      words_[i].store(words[i], internal::memory_order_relaxed);
+    }
+  }
+
+  void copy_out(T *value) const {
+    word words[num_words];
+    for (int i = 0; i < num_words; ++i) {
+      words[i] = words_[i].load(internal::memory_order_relaxed);
+    }
+    memcpy(value, words, sizeof(T));
+  }
+
+  /* Readers only touch this line, keep it away from neighbours. */
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<unsigned int> sequence_;
+  internal::atomic<word> words_[num_words];
+  char pad1_[FUTURE_CACHELINE_SIZE];
+
+ private:
+  seqlock(const seqlock& other);
+  void operator=(const seqlock& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_SEQLOCK_H_ */
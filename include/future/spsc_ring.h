@@ -0,0 +1,205 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_SPSC_RING_H_
+#define FUTURE_SPSC_RING_H_
+
+#include <cstddef>
+#include <algorithm>
+
+#include "future/atomic.h"
+
+namespace future {
+
+/* Wait-free single-producer single-consumer ring buffer.
+ *
+ * Every side keeps a cached copy of the other side's index and only
+ * re-reads the shared one when the cached value says the ring is full
+ * (or empty), so in the steady state the sides don't touch each other's
+ * cache lines. Batch operations publish any number of items with a single
+ * release store.
+ *
+ * Producer side: try_push(), push_n(), reserve()/commit().
+ * Consumer side: try_pop(), pop_n(), peek()/consume().
+ *
+ * T is to be default constructible and assignable.
+ */
+template <typename T>
+class spsc_ring {
+ public:
+  /* Capacity is rounded up to a power of two. */
+  explicit spsc_ring(size_t capacity)
+      : tail_(0),
+        cached_head_(0),
+        head_(0),
+        cached_tail_(0) {
+    capacity_ = 2;
+    while (capacity_ < capacity) {
+      capacity_ *= 2;
+    }
+    mask_ = capacity_ - 1;
+    items_ = new T[capacity_];
+  }
+
+  ~spsc_ring() {
+    delete [] items_;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /* Producer side. */
+
+  bool try_push(const T& value) {
+    size_t tail = tail_.load(internal::memory_order_relaxed);
+    if (num_free(tail, 1) == 0) {
+      return false;
+    }
+    items_[tail & mask_] = value;
+    tail_.store(tail + 1, internal::memory_order_release);
+    return true;
+  }
+
+  /* Push as many values as fit, returns number of pushed values. */
+  size_t push_n(const T *values, size_t count) {
+    size_t tail = tail_.load(internal::memory_order_relaxed);
+    count = std::min(count, num_free(tail, count));
+    if (count == 0) {
+      return 0;
+    }
+    size_t index = tail & mask_;
+    size_t first_part = std::min(count, capacity_ - index);
+    std::copy(values, values + first_part, items_ + index);
+    std::copy(values + first_part, values + count, items_);
+    tail_.store(tail + count, internal::memory_order_release);
+    return count;
+  }
+
+  /* Zero-copy push: get up to count contiguous slots to be written
+   * directly, returns number of slots which could be less than requested
+   * when the ring is almost full or wraps around. Slots become visible to
+   * the consumer after commit().
+   */
+  size_t reserve(size_t count, T **slots) {
+    size_t tail = tail_.load(internal::memory_order_relaxed);
+    size_t index = tail & mask_;
+    count = std::min(count, num_free(tail, count));
+    count = std::min(count, capacity_ - index);
+    *slots = items_ + index;
+    return count;
+  }
+
+  void commit(size_t count) {
+    size_t tail = tail_.load(internal::memory_order_relaxed);
+    tail_.store(tail + count, internal::memory_order_release);
+  }
+
+  /* Consumer side. */
+
+  bool try_pop(T *value) {
+    size_t head = head_.load(internal::memory_order_relaxed);
+    if (num_available(head, 1) == 0) {
+      return false;
+    }
+    *value = items_[head & mask_];
+    head_.store(head + 1, internal::memory_order_release);
+    return true;
+  }
+
+  /* Pop up to count values, returns number of popped values. */
+  size_t pop_n(T *values, size_t count) {
+    size_t head = head_.load(internal::memory_order_relaxed);
+    count = std::min(count, num_available(head, count));
+    if (count == 0) {
+      return 0;
+    }
+    size_t index = head & mask_;
+    size_t first_part = std::min(count, capacity_ - index);
+    std::copy(items_ + index, items_ + index + first_part, values);
+    std::copy(items_, items_ + (count - first_part), values + first_part);
+    head_.store(head + count, internal::memory_order_release);
+    return count;
+  }
+
+  /* Zero-copy pop: get up to count contiguous readable slots, which stay
+   * valid until consume() hands them back to the producer.
+   */
+  size_t peek(size_t count, const T **slots) {
+    size_t head = head_.load(internal::memory_order_relaxed);
+    size_t index = head & mask_;
+    count = std::min(count, num_available(head, count));
+    count = std::min(count, capacity_ - index);
+    *slots = items_ + index;
+    return count;
+  }
+
+  void consume(size_t count) {
+    size_t head = head_.load(internal::memory_order_relaxed);
+    head_.store(head + count, internal::memory_order_release);
+  }
+
+ protected:
+  /* Number of free slots, shared head is only read when the cached one
+   * doesn't have enough of them.
+   */
+  inline size_t num_free(size_t tail, size_t wanted) {
+    size_t num_free = capacity_ - (tail - cached_head_);
+    if (num_free < wanted) {
+      cached_head_ = head_.load(internal::memory_order_acquire);
+      num_free = capacity_ - (tail - cached_head_);
+    }
+    return num_free;
+  }
+
+  inline size_t num_available(size_t head, size_t wanted) {
+    size_t num_available = cached_tail_ - head;
+    if (num_available < wanted) {
+      cached_tail_ = tail_.load(internal::memory_order_acquire);
+      num_available = cached_tail_ - head;
+    }
+    return num_available;
+  }
+
+  T *items_;
+  size_t capacity_;
+  size_t mask_;
+
+  /* Written by producer. */
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<size_t> tail_;
+  size_t cached_head_;
+
+  /* Written by consumer. */
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<size_t> head_;
+  size_t cached_tail_;
+  char pad2_[FUTURE_CACHELINE_SIZE];
+
+ private:
+  spsc_ring(const spsc_ring& other);
+  void operator=(const spsc_ring& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_SPSC_RING_H_ */
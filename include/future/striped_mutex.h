@@ -0,0 +1,237 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_STRIPED_MUTEX_H_
+#define FUTURE_STRIPED_MUTEX_H_
+
+#include <stdint.h>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <string>
+
+#include "future/atomic.h"
+#include "future/mutex.h"
+
+namespace future {
+
+/* Hash of the key used to select a stripe. Works for integral and enum
+ * keys, pointers and strings. Specialize it for other key types.
+ */
+template <typename Key>
+struct stripe_hash {
+  size_t operator()(const Key& key) const {
+    return (size_t)key;
+  }
+};
+
+template <typename T>
+struct stripe_hash<T*> {
+  size_t operator()(T *key) const {
+    return (size_t)reinterpret_cast<uintptr_t>(key);
+  }
+};
+
+template <>
+struct stripe_hash<std::string> {
+  size_t operator()(const std::string& key) const {
+    /* FNV-1a. */
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i) {
+      hash ^= (unsigned char)key[i];
+      hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+  }
+};
+
+/* Fixed array of mutexes, each one on its own cache line(s), guarding data
+ * sharded by key. Keys which hash to the same stripe share a mutex, so the
+ * stripe count is to be well above the number of threads.
+ */
+template <size_t N>
+class striped_mutex {
+ public:
+  /* Lock of the stripe the key belongs to. */
+  class scoped_lock {
+   public:
+    template <typename Key>
+    scoped_lock(striped_mutex& striped, const Key& key)
+        : lock_(striped.stripe_mutex(striped.index_of(key))) {}
+
+    void lock() {
+      lock_.lock();
+    }
+
+    void unlock() {
+      lock_.unlock();
+    }
+
+   protected:
+    mutex::scoped_lock lock_;
+
+   private:
+    scoped_lock(const scoped_lock& other);
+    void operator=(const scoped_lock& other);
+  };
+
+  /* Lock of all the stripes the given keys belong to. Stripes are sorted
+   * and deduplicated, then acquired in ascending order, so overlapping multi
+   * locks never deadlock and each stripe is acquired once no matter how many
+   * of the keys share it.
+   */
+  class multi_lock {
+   public:
+    template <typename Key>
+    multi_lock(striped_mutex& striped, const Key& first, const Key& second)
+        : striped_(striped),
+          indices_(inline_indices_),
+          num_indices_(0) {
+      indices_[num_indices_++] = striped.index_of(first);
+      indices_[num_indices_++] = striped.index_of(second);
+      lock();
+    }
+
+    template <typename Key>
+    multi_lock(striped_mutex& striped, const Key *keys, size_t num_keys)
+        : striped_(striped),
+          indices_(num_keys <= max_inline_keys ? inline_indices_
+                                               : new size_t[num_keys]),
+          num_indices_(0) {
+      for (size_t i = 0; i < num_keys; ++i) {
+        indices_[num_indices_++] = striped.index_of(keys[i]);
+      }
+      lock();
+    }
+
+    ~multi_lock() {
+      for (size_t i = num_indices_; i-- > 0;) {
+        striped_.stripe_mutex(indices_[i]).unlock();
+      }
+      if (indices_ != inline_indices_) {
+        delete [] indices_;
+      }
+    }
+
+   protected:
+    enum { max_inline_keys = 8 };
+
+    void lock() {
+      std::sort(indices_, indices_ + num_indices_);
+      num_indices_ = std::unique(indices_, indices_ + num_indices_) -
+                     indices_;
+      for (size_t i = 0; i < num_indices_; ++i) {
+        striped_.stripe_mutex(indices_[i]).lock();
+      }
+    }
+
+    striped_mutex& striped_;
+    size_t inline_indices_[max_inline_keys];
+    size_t *indices_;
+    size_t num_indices_;
+
+   private:
+    multi_lock(const multi_lock& other);
+    void operator=(const multi_lock& other);
+  };
+
+  /* Name is shared by all the stripes for contention statistics. */
+  explicit striped_mutex(const char *name = NULL) {
+    void *memory;
+    if (posix_memalign(&memory, FUTURE_CACHELINE_SIZE,
+                       N * stripe_size) != 0) {
+      throw std::bad_alloc();
+    }
+    stripes_ = static_cast<char*>(memory);
+    for (size_t i = 0; i < N; ++i) {
+      new (stripes_ + i * stripe_size) mutex(name);
+    }
+  }
+
+  ~striped_mutex() {
+    for (size_t i = 0; i < N; ++i) {
+      stripe_mutex(i).~mutex();
+    }
+    free(stripes_);
+  }
+
+  static size_t size() {
+    return N;
+  }
+
+  template <typename Key>
+  size_t index_of(const Key& key) const {
+    return index_of_hash(stripe_hash<Key>()(key));
+  }
+
+  /* Stripe for an already computed hash. Hash is mixed first, so keys which
+   * differ only in high bits or are multiples of N still spread.
+   */
+  static size_t index_of_hash(size_t hash) {
+    uint64_t mixed = (uint64_t)hash;
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    return (size_t)(mixed % N);
+  }
+
+  mutex& stripe_mutex(size_t index) {
+    assert(index < N);
+    return *reinterpret_cast<mutex*>(stripes_ + index * stripe_size);
+  }
+
+  /* Locks all the stripes in order, for operations over the whole table
+   * such as resize or clear.
+   */
+  void lock_all() {
+    for (size_t i = 0; i < N; ++i) {
+      stripe_mutex(i).lock();
+    }
+  }
+
+  void unlock_all() {
+    for (size_t i = N; i-- > 0;) {
+      stripe_mutex(i).unlock();
+    }
+  }
+
+ protected:
+  /* Every mutex starts a new cache line, array itself is aligned to the
+   * cache line.
+   */
+  enum {
+    stripe_size = (sizeof(mutex) + FUTURE_CACHELINE_SIZE - 1) /
+                  FUTURE_CACHELINE_SIZE * FUTURE_CACHELINE_SIZE
+  };
+
+  char *stripes_;
+
+ private:
+  striped_mutex(const striped_mutex& other);
+  void operator=(const striped_mutex& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_STRIPED_MUTEX_H_ */
@@ -0,0 +1,366 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_TASK_GRAPH_H_
+#define FUTURE_TASK_GRAPH_H_
+
+#include <cassert>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/function.h"
+#include "future/futex.h"
+#include "future/thread_pool.h"
+
+namespace future {
+
+/* Directed acyclic graph of tasks, every task starts once all the tasks it
+ * depends on are finished. Graphs with cycles are rejected by run().
+ *
+ * Graph is built once and can be run many times, all the per-run state is
+ * allocated when the graph is run for the first time after modification.
+ * Every node has an atomic counter of unfinished predecessors, the thread
+ * which brings it to zero makes the node ready. Ready nodes are put to a
+ * queue of the run which is drained by the calling thread and by helper
+ * tasks on the pool, a thread which made nodes ready continues with one of
+ * them itself and only submits helpers for the rest.
+ *
+ * Run is finished once all the nodes are, without waiting for the helpers:
+ * the calling thread might be a worker of the same pool which would never
+ * get to its own helpers. Per-run state is reference counted, so a helper
+ * which starts late finds the queue empty and only drops its reference.
+ *
+ * Running the same graph from several threads at once is not supported.
+ */
+class task_graph {
+ public:
+  typedef function::function<void(void)> function_type;
+  typedef int node_id;
+
+  task_graph()
+      : state_(NULL),
+        pool_(NULL),
+        cycle_check_(cycle_unknown) {}
+
+  ~task_graph() {
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      delete nodes_[i];
+    }
+    if (state_ != NULL) {
+      state_->release();
+    }
+  }
+
+  node_id add_node(function_type function) {
+    node *new_node = new node(function);
+    nodes_.push_back(new_node);
+    cycle_check_ = cycle_unknown;
+    return (node_id)nodes_.size() - 1;
+  }
+
+  /* Node after is only started once node before is finished. */
+  void add_dependency(node_id before, node_id after) {
+    assert(before >= 0 && before < num_nodes());
+    assert(after >= 0 && after < num_nodes());
+    assert(before != after);
+    nodes_[before]->successors.push_back(after);
+    ++nodes_[after]->num_predecessors;
+    cycle_check_ = cycle_unknown;
+  }
+
+  int num_nodes() const {
+    return (int)nodes_.size();
+  }
+
+  /* Result is cached until the graph is modified. */
+  bool has_cycle() {
+    if (cycle_check_ == cycle_unknown) {
+      cycle_check_ = find_cycle() ? cycle_found : cycle_none;
+    }
+    return cycle_check_ == cycle_found;
+  }
+
+  /* Runs all the nodes and waits for them to finish. The calling thread
+   * takes part in running the nodes.
+   *
+   * Returns false without running anything if the graph has a cycle, since
+   * nodes on the cycle could never start.
+   */
+  bool run(thread_pool *pool = NULL) {
+    using internal::memory_order_relaxed;
+    int num_nodes = this->num_nodes();
+    if (num_nodes == 0) {
+      return true;
+    }
+    if (has_cycle()) {
+      return false;
+    }
+    if (pool == NULL) {
+      pool = &thread_pool::default_pool();
+    }
+    pool_ = pool;
+    allocate_run_state();
+    run_state *state = state_;
+    for (int i = 0; i < num_nodes; ++i) {
+      state->pending[i].store(nodes_[i]->num_predecessors,
+                              memory_order_relaxed);
+      state->ready[i].store(0, memory_order_relaxed);
+    }
+    state->ready_head.store(0, memory_order_relaxed);
+    state->ready_tail.store(0, memory_order_relaxed);
+    state->outstanding.store(num_nodes * outstanding_increment,
+                             memory_order_relaxed);
+    int num_roots = 0;
+    for (int i = 0; i < num_nodes; ++i) {
+      if (nodes_[i]->num_predecessors == 0) {
+        state->push_ready(i);
+        ++num_roots;
+      }
+    }
+    /* Calling thread takes one of the roots. */
+    submit_helpers(state, num_roots - 1);
+    drain(state);
+    state->wait();
+    return true;
+  }
+
+ protected:
+  struct node {
+    explicit node(function_type function)
+        : function(function),
+          num_predecessors(0) {}
+
+    function_type function;
+    std::vector<node_id> successors;
+    int num_predecessors;
+  };
+
+  /* Lowest bit of the unfinished nodes counter tells whether the calling
+   * thread sleeps on it.
+   */
+  enum {
+    has_waiters = 1,
+    outstanding_increment = 2
+  };
+
+  enum {
+    cycle_unknown,
+    cycle_none,
+    cycle_found
+  };
+
+  /* Kahn's algorithm: graph is acyclic if every node can be reached by
+   * repeatedly removing nodes without predecessors.
+   */
+  bool find_cycle() const {
+    int num_nodes = this->num_nodes();
+    std::vector<int> pending(num_nodes);
+    std::vector<node_id> ready;
+    for (int i = 0; i < num_nodes; ++i) {
+      pending[i] = nodes_[i]->num_predecessors;
+      if (pending[i] == 0) {
+        ready.push_back(i);
+      }
+    }
+    int num_visited = 0;
+    while (!ready.empty()) {
+      node_id id = ready.back();
+      ready.pop_back();
+      ++num_visited;
+      const std::vector<node_id>& successors = nodes_[id]->successors;
+      for (size_t i = 0; i < successors.size(); ++i) {
+        if (--pending[successors[i]] == 0) {
+          ready.push_back(successors[i]);
+        }
+      }
+    }
+    return num_visited != num_nodes;
+  }
+
+  /* State of a single run, shared by the graph and its helper tasks. */
+  struct run_state {
+    explicit run_state(int num_nodes)
+        : pending(new internal::atomic<int>[num_nodes]),
+          ready(new internal::atomic<int>[num_nodes]),
+          num_nodes(num_nodes),
+          ready_head(0),
+          ready_tail(0),
+          outstanding(0),
+          num_references(1) {}
+
+    ~run_state() {
+      delete [] pending;
+      delete [] ready;
+    }
+
+    void add_references(int num_references) {
+      this->num_references.fetch_add(num_references,
+                                     internal::memory_order_relaxed);
+    }
+
+    void release() {
+      if (num_references.fetch_sub(1, internal::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+    }
+
+    /* Every node is pushed exactly once per run, so the queue is an array
+     * with a slot per node. Slots hold node id plus one, zero means the
+     * pushing thread did not publish the node yet.
+     */
+    void push_ready(node_id id) {
+      int index = ready_tail.fetch_add(1, internal::memory_order_relaxed);
+      ready[index].store(id + 1, internal::memory_order_release);
+    }
+
+    bool pop_ready(node_id *id) {
+      int head = ready_head.load(internal::memory_order_relaxed);
+      for (;;) {
+        if (head >= num_nodes) {
+          return false;
+        }
+        int value = ready[head].load(internal::memory_order_acquire);
+        if (value == 0) {
+          return false;
+        }
+        if (ready_head.compare_exchange_weak(
+                head, head + 1, internal::memory_order_relaxed)) {
+          *id = value - 1;
+          return true;
+        }
+      }
+    }
+
+    /* Run might be over once the last node is finished, the graph is not
+     * to be accessed after this.
+     */
+    void finish_node() {
+      int previous = outstanding.fetch_sub(outstanding_increment,
+                                           internal::memory_order_acq_rel);
+      if ((previous & ~has_waiters) == outstanding_increment &&
+          (previous & has_waiters) != 0) {
+        internal::futex_wake_all(outstanding.address());
+      }
+    }
+
+    void wait() {
+      using internal::memory_order_acquire;
+      using internal::memory_order_acq_rel;
+      for (;;) {
+        int current = outstanding.load(memory_order_acquire);
+        if ((current & ~has_waiters) == 0) {
+          return;
+        }
+        if ((current & has_waiters) == 0 &&
+            !outstanding.compare_exchange_strong(current,
+                                                 current | has_waiters,
+                                                 memory_order_acq_rel)) {
+          continue;
+        }
+        internal::futex_wait(outstanding.address(), current | has_waiters);
+      }
+    }
+
+    internal::atomic<int> *pending;
+    internal::atomic<int> *ready;
+    int num_nodes;
+    internal::atomic<int> ready_head;
+    internal::atomic<int> ready_tail;
+    /* Unfinished nodes. */
+    internal::atomic<int> outstanding;
+    /* Graph holds one reference, every pending helper holds another. */
+    internal::atomic<int> num_references;
+  };
+
+  /* State is reused unless a helper of the previous run still holds it. */
+  void allocate_run_state() {
+    if (state_ != NULL) {
+      if (state_->num_nodes == num_nodes() &&
+          state_->num_references.load(internal::memory_order_acquire) == 1) {
+        return;
+      }
+      state_->release();
+    }
+    state_ = new run_state(num_nodes());
+  }
+
+  void drain(run_state *state) {
+    node_id id;
+    while (state->pop_ready(&id)) {
+      run_node(state, id);
+    }
+  }
+
+  void run_node(run_state *state, node_id id) {
+    node *current = nodes_[id];
+    current->function();
+    int num_ready = 0;
+    const std::vector<node_id>& successors = current->successors;
+    for (size_t i = 0; i < successors.size(); ++i) {
+      node_id successor = successors[i];
+      if (state->pending[successor].fetch_sub(
+              1, internal::memory_order_acq_rel) == 1) {
+        state->push_ready(successor);
+        ++num_ready;
+      }
+    }
+    /* Current thread continues with one of the ready nodes. */
+    submit_helpers(state, num_ready - 1);
+    state->finish_node();
+  }
+
+  void submit_helpers(run_state *state, int num_helpers) {
+    if (num_helpers <= 0) {
+      return;
+    }
+    state->add_references(num_helpers);
+    for (int i = 0; i < num_helpers; ++i) {
+      pool_->submit(::future::bind::function_bind(&task_graph::run_helper,
+                                                  this,
+                                                  state));
+    }
+  }
+
+  /* Graph is only accessed while there are nodes to run, which means the
+   * run is not over yet.
+   */
+  void run_helper(run_state *state) {
+    drain(state);
+    state->release();
+  }
+
+  std::vector<node*> nodes_;
+
+  /* State of the latest run, reference held by the graph. */
+  run_state *state_;
+  thread_pool *pool_;
+  int cycle_check_;
+
+ private:
+  task_graph(const task_graph& other);
+  void operator=(const task_graph& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_TASK_GRAPH_H_ */
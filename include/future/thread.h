@@ -0,0 +1,274 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_THREAD_H_
+#define FUTURE_THREAD_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <limits.h>
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/function.h"
+
+namespace future {
+
+/* Set of CPU indices, used for thread affinity and topology. */
+class cpu_set {
+ public:
+  cpu_set() {}
+
+  void add(int cpu) {
+    assert(cpu >= 0);
+    if ((size_t)cpu >= cpus_.size()) {
+      cpus_.resize(cpu + 1, false);
+    }
+    cpus_[cpu] = true;
+  }
+
+  void remove(int cpu) {
+    if (contains(cpu)) {
+      cpus_[cpu] = false;
+    }
+  }
+
+  bool contains(int cpu) const {
+    return cpu >= 0 && (size_t)cpu < cpus_.size() && cpus_[cpu];
+  }
+
+  int count() const {
+    int count = 0;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      count += cpus_[i] ? 1 : 0;
+    }
+    return count;
+  }
+
+  bool empty() const {
+    return count() == 0;
+  }
+
+  /* One past the biggest CPU index which could be in the set. */
+  int size() const {
+    return (int)cpus_.size();
+  }
+
+  std::vector<int> to_vector() const {
+    std::vector<int> result;
+    for (size_t i = 0; i < cpus_.size(); ++i) {
+      if (cpus_[i]) {
+        result.push_back((int)i);
+      }
+    }
+    return result;
+  }
+
+  bool operator==(const cpu_set& other) const {
+    int size = std::max(this->size(), other.size());
+    for (int i = 0; i < size; ++i) {
+      if (contains(i) != other.contains(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const cpu_set& other) const {
+    return !(*this == other);
+  }
+
+  /* Parse kernel's CPU list format, for example "0-3,8,10-11". */
+  static cpu_set from_list(const std::string& list) {
+    cpu_set result;
+    const char *current = list.c_str();
+    while (*current != '\0') {
+      char *end;
+      long first = strtol(current, &end, 10);
+      if (end == current) {
+        break;
+      }
+      long last = first;
+      current = end;
+      if (*current == '-') {
+        last = strtol(current + 1, &end, 10);
+        current = end;
+      }
+      for (long cpu = first; cpu <= last; ++cpu) {
+        result.add((int)cpu);
+      }
+      while (*current == ',' || *current == ' ' || *current == '\n') {
+        ++current;
+      }
+    }
+    return result;
+  }
+
+ protected:
+  std::vector<bool> cpus_;
+};
+
+/* Thread of execution running a function. Thread is to be either joined
+ * or detached before the object is destroyed.
+ */
+class thread {
+ public:
+  typedef function::function<void(void)> function_type;
+
+  thread() : joinable_(false) {}
+
+  /* Zero stack size means system default. */
+  explicit thread(function_type function, size_t stack_size = 0)
+      : joinable_(false) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    if (stack_size != 0) {
+      size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+      stack_size = std::max(stack_size, (size_t)PTHREAD_STACK_MIN);
+      stack_size = (stack_size + page_size - 1) / page_size * page_size;
+      pthread_attr_setstacksize(&attributes, stack_size);
+    }
+    function_type *function_copy = new function_type(function);
+    if (pthread_create(&thread_, &attributes, thread_main,
+                       function_copy) == 0) {
+      joinable_ = true;
+    } else {
+      delete function_copy;
+    }
+    pthread_attr_destroy(&attributes);
+  }
+
+  ~thread() {
+    assert(!joinable_);
+  }
+
+  /* False for default constructed threads, threads which failed to start
+   * and threads which are already joined or detached.
+   */
+  bool joinable() const {
+    return joinable_;
+  }
+
+  void join() {
+    assert(joinable_);
+    pthread_join(thread_, NULL);
+    joinable_ = false;
+  }
+
+  void detach() {
+    assert(joinable_);
+    pthread_detach(thread_);
+    joinable_ = false;
+  }
+
+  pthread_t native_handle() const {
+    return thread_;
+  }
+
+  /* Affinity and name could only be changed for the calling thread on some
+   * platforms, so these return false when not supported.
+   */
+
+  bool set_affinity(const cpu_set& cpus) {
+    assert(joinable_);
+    return set_affinity(thread_, cpus);
+  }
+
+  bool set_name(const char *name) {
+    assert(joinable_);
+    return set_name(thread_, name);
+  }
+
+  static bool set_current_affinity(const cpu_set& cpus) {
+    return set_affinity(pthread_self(), cpus);
+  }
+
+  static bool set_current_name(const char *name) {
+    return set_name(pthread_self(), name);
+  }
+
+  static int hardware_concurrency() {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? (int)num_cpus : 1;
+  }
+
+ protected:
+  static void *thread_main(void *arg) {
+    function_type *function = reinterpret_cast<function_type*>(arg);
+    (*function)();
+    delete function;
+    return NULL;
+  }
+
+  static bool set_affinity(pthread_t thread, const cpu_set& cpus) {
+#if defined(__linux__)
+    cpu_set_t native_cpus;
+    CPU_ZERO(&native_cpus);
+    for (int cpu = 0; cpu < cpus.size() && cpu < CPU_SETSIZE; ++cpu) {
+      if (cpus.contains(cpu)) {
+        CPU_SET(cpu, &native_cpus);
+      }
+    }
+    return pthread_setaffinity_np(thread,
+                                  sizeof(native_cpus),
+                                  &native_cpus) == 0;
+#else
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+  }
+
+  static bool set_name(pthread_t thread, const char *name) {
+#if defined(__linux__)
+    /* Kernel limits names to 15 characters. */
+    std::string short_name = std::string(name).substr(0, 15);
+    return pthread_setname_np(thread, short_name.c_str()) == 0;
+#else
+    if (!pthread_equal(thread, pthread_self())) {
+      return false;
+    }
+    return pthread_setname_np(name) == 0;
+#endif
+  }
+
+  pthread_t thread_;
+  bool joinable_;
+
+ private:
+  thread(const thread& other);
+  void operator=(const thread& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_THREAD_H_ */
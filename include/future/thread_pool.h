@@ -0,0 +1,410 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_THREAD_POOL_H_
+#define FUTURE_THREAD_POOL_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <pthread.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "future/atomic.h"
+#include "future/bind.h"
+#include "future/executor.h"
+#include "future/futex.h"
+#include "future/mutex.h"
+#include "future/thread.h"
+
+namespace future {
+namespace internal {
+
+/* Chase-Lev work-stealing deque (with memory orders from "Correct and
+ * Efficient Work-Stealing for Weak Memory Models" by Le et al).
+ *
+ * Owner thread pushes and takes items from the bottom, any other thread
+ * can steal items from the top.
+ */
+template <typename T>
+class work_stealing_deque {
+ public:
+  explicit work_stealing_deque(int64_t capacity = 256)
+      : top_(0),
+        bottom_(0),
+        array_(new circular_array(capacity)) {}
+
+  ~work_stealing_deque() {
+    delete array_.load(memory_order_relaxed);
+    for (size_t i = 0; i < retired_arrays_.size(); ++i) {
+      delete retired_arrays_[i];
+    }
+  }
+
+  /* Owner only. */
+  void push(T *item) {
+    int64_t bottom = bottom_.load(memory_order_relaxed);
+    int64_t top = top_.load(memory_order_acquire);
+    circular_array *array = array_.load(memory_order_relaxed);
+    if (bottom - top > array->size - 1) {
+      /* Thieves might still be reading from the old array, so it's only
+       * freed together with the deque.
+       */
+      retired_arrays_.push_back(array);
+      array = array->grow(bottom, top);
+      array_.store(array, memory_order_release);
+    }
+    array->put(bottom, item);
+    atomic_thread_fence(memory_order_release);
+    bottom_.store(bottom + 1, memory_order_relaxed);
+  }
+
+  /* Owner only, returns NULL if the deque is empty. */
+  T *take() {
+    int64_t bottom = bottom_.load(memory_order_relaxed) - 1;
+    circular_array *array = array_.load(memory_order_relaxed);
+    bottom_.store(bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = top_.load(memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, memory_order_relaxed);
+      return NULL;
+    }
+    T *item = array->get(bottom);
+    if (top == bottom) {
+      /* Last item, race with thieves for it. */
+      if (!top_.compare_exchange_strong(top, top + 1)) {
+        item = NULL;
+      }
+      bottom_.store(bottom + 1, memory_order_relaxed);
+    }
+    return item;
+  }
+
+  /* Any thread, returns NULL if the deque is empty or the race for the
+   * item was lost.
+   */
+  T *steal() {
+    int64_t top = top_.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = bottom_.load(memory_order_acquire);
+    if (top >= bottom) {
+      return NULL;
+    }
+    circular_array *array = array_.load(memory_order_acquire);
+    T *item = array->get(top);
+    if (!top_.compare_exchange_strong(top, top + 1)) {
+      return NULL;
+    }
+    return item;
+  }
+
+  /* Approximate, only to be used as a hint. */
+  bool empty() const {
+    return bottom_.load(memory_order_relaxed) <=
+           top_.load(memory_order_relaxed);
+  }
+
+ protected:
+  struct circular_array {
+    explicit circular_array(int64_t size)
+        : size(size),
+          items(new atomic<T*>[size]) {}
+
+    ~circular_array() {
+      delete [] items;
+    }
+
+    inline T *get(int64_t index) {
+      return items[index & (size - 1)].load(memory_order_relaxed);
+    }
+
+    inline void put(int64_t index, T *item) {
+      items[index & (size - 1)].store(item, memory_order_relaxed);
+    }
+
+    circular_array *grow(int64_t bottom, int64_t top) {
+      circular_array *array = new circular_array(size * 2);
+      for (int64_t i = top; i < bottom; ++i) {
+        array->put(i, get(i));
+      }
+      return array;
+    }
+
+    int64_t size;
+    atomic<T*> *items;
+  };
+
+  /* Top is modified by thieves, bottom by the owner. */
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  atomic<int64_t> top_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+  atomic<int64_t> bottom_;
+  atomic<circular_array*> array_;
+  std::vector<circular_array*> retired_arrays_;
+  char pad2_[FUTURE_CACHELINE_SIZE];
+};
+
+}  /* namespace internal */
+
+/* Pool of worker threads with work stealing.
+ *
+ * Every worker has own deque of tasks, tasks submitted from a worker go to
+ * its deque without any locking, tasks submitted from other threads go to
+ * a shared injection queue. Idle workers steal from random victims and
+ * park on a futex when there is nothing to do.
+ */
+class thread_pool : public executor {
+ public:
+  /* Zero number of threads means one thread per online CPU. */
+  explicit thread_pool(int num_threads = 0)
+      : injection_mutex_("thread_pool_injection"),
+        num_injected_(0),
+        wake_epoch_(0),
+        num_sleepers_(0),
+        stopping_(0),
+        num_started_(0) {
+    if (num_threads <= 0) {
+      num_threads = hardware_concurrency();
+    }
+    workers_.resize(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      workers_[i] = new worker(this, i);
+    }
+    /* Worker which failed to start has no thread handle, nothing is pushed
+     * to its deque since that's only done by the worker itself.
+     */
+    for (int i = 0; i < num_threads; ++i) {
+      thread *handle = new thread(
+          ::future::bind::function_bind(worker_main, workers_[i]));
+      if (handle->joinable()) {
+        workers_[i]->thread_handle = handle;
+        ++num_started_;
+      } else {
+        delete handle;
+      }
+    }
+  }
+
+  /* Finishes all the submitted tasks before returning. */
+  ~thread_pool() {
+    stopping_.store(1);
+    wake_epoch_.fetch_add(1);
+    internal::futex_wake_all(wake_epoch_.address());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      if (workers_[i]->thread_handle != NULL) {
+        workers_[i]->thread_handle->join();
+      }
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      delete workers_[i]->thread_handle;
+      delete workers_[i];
+    }
+  }
+
+  using executor::submit;
+
+  void submit(task_type task) {
+    /* No thread could be started, nobody would ever run queued tasks. */
+    if (num_started_ == 0) {
+      task();
+      return;
+    }
+    task_type *task_copy = new task_type(task);
+    worker *current = current_worker();
+    if (current != NULL && current->pool == this) {
+      current->deque.push(task_copy);
+    } else {
+      mutex::scoped_lock lock(injection_mutex_);
+      injected_.push_back(task_copy);
+      num_injected_.fetch_add(1, internal::memory_order_relaxed);
+    }
+    wake_one();
+  }
+
+  /* Number of threads running the tasks: workers which actually started,
+   * or the submitting thread itself if none of them did.
+   */
+  int num_threads() const {
+    return std::max(num_started_, 1);
+  }
+
+  static int hardware_concurrency() {
+    return thread::hardware_concurrency();
+  }
+
+  /* Process-wide pool with a thread per CPU, created on first use. It is
+   * never destroyed, so it can be used from static destructors.
+   */
+  static thread_pool& default_pool() {
+    static thread_pool *pool = new thread_pool();
+    return *pool;
+  }
+
+ protected:
+  struct worker {
+    worker(thread_pool *pool, int index)
+        : pool(pool),
+          index(index),
+          random_state(index * 2654435761U + 1),
+          thread_handle(NULL) {}
+
+    thread_pool *pool;
+    int index;
+    uint32_t random_state;
+    thread *thread_handle;
+    internal::work_stealing_deque<task_type> deque;
+  };
+
+  /* Number of find_task() attempts before the worker goes to sleep. */
+  enum { num_spins_before_park = 64 };
+
+  static worker *&current_worker() {
+    static __thread worker *current = NULL;
+    return current;
+  }
+
+  static void worker_main(worker *self) {
+    char name[16];
+    snprintf(name, sizeof(name), "future-pool-%d", self->index);
+    thread::set_current_name(name);
+    current_worker() = self;
+    self->pool->worker_loop(self);
+    current_worker() = NULL;
+  }
+
+  void worker_loop(worker *self) {
+    using internal::memory_order_acquire;
+    int num_spins = 0;
+    for (;;) {
+      task_type *task = find_task(self);
+      if (task != NULL) {
+        run_task(task);
+        num_spins = 0;
+        continue;
+      }
+      if (stopping_.load(memory_order_acquire)) {
+        break;
+      }
+      if (num_spins < num_spins_before_park) {
+        ++num_spins;
+        internal::cpu_relax();
+        continue;
+      }
+      /* Announce we're about to sleep and re-check for work, submitters
+       * check for sleepers after publishing tasks, so either we see the
+       * task or they see us and bump the epoch.
+       */
+      int epoch = wake_epoch_.load(memory_order_acquire);
+      num_sleepers_.fetch_add(1);
+      task = find_task(self);
+      if (task == NULL && !stopping_.load()) {
+        internal::futex_wait(wake_epoch_.address(), epoch);
+      }
+      num_sleepers_.fetch_sub(1);
+      if (task != NULL) {
+        run_task(task);
+      }
+      num_spins = 0;
+    }
+  }
+
+  task_type *find_task(worker *self) {
+    task_type *task = self->deque.take();
+    if (task != NULL) {
+      return task;
+    }
+    if (num_injected_.load(internal::memory_order_relaxed) != 0) {
+      mutex::scoped_lock lock(injection_mutex_);
+      if (!injected_.empty()) {
+        task = injected_.front();
+        injected_.pop_front();
+        num_injected_.fetch_sub(1, internal::memory_order_relaxed);
+        return task;
+      }
+    }
+    return steal_task(self);
+  }
+
+  task_type *steal_task(worker *self) {
+    int num_workers = (int)workers_.size();
+    if (num_workers <= 1) {
+      return NULL;
+    }
+    /* Xorshift is good enough to spread thieves across victims. */
+    uint32_t x = self->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->random_state = x;
+    int start = (int)(x % (uint32_t)num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+      worker *victim = workers_[(start + i) % num_workers];
+      if (victim == self) {
+        continue;
+      }
+      task_type *task = victim->deque.steal();
+      if (task != NULL) {
+        return task;
+      }
+    }
+    return NULL;
+  }
+
+  static void run_task(task_type *task) {
+    (*task)();
+    delete task;
+  }
+
+  void wake_one() {
+    internal::atomic_thread_fence(internal::memory_order_seq_cst);
+    if (num_sleepers_.load(internal::memory_order_relaxed) != 0) {
+      wake_epoch_.fetch_add(1);
+      internal::futex_wake(wake_epoch_.address(), 1);
+    }
+  }
+
+  std::vector<worker*> workers_;
+
+  mutex injection_mutex_;
+  std::deque<task_type*> injected_;
+  internal::atomic<int> num_injected_;
+
+  char pad0_[FUTURE_CACHELINE_SIZE];
+  internal::atomic<int> wake_epoch_;
+  internal::atomic<int> num_sleepers_;
+  internal::atomic<int> stopping_;
+  char pad1_[FUTURE_CACHELINE_SIZE];
+
+  /* Written by the constructor only. */
+  int num_started_;
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_THREAD_POOL_H_ */
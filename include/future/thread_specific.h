@@ -0,0 +1,325 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_THREAD_SPECIFIC_H_
+#define FUTURE_THREAD_SPECIFIC_H_
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <pthread.h>
+#else
+#  error "Unsupported threading model on your system"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace future {
+
+namespace internal {
+
+/* Every thread has a table of slots in compiler TLS, indexed by the slot
+ * index of thread_specific_ptr. Lookups never go through pthread keys,
+ * a single key is only used to run cleanup when thread exits.
+ */
+
+typedef void (*tls_generic_function)();
+typedef void (*tls_cleanup_thunk)(void *value, tls_generic_function cleanup);
+
+struct tls_slot {
+  void *value;
+  /* Generation of thread_specific_ptr which owns the value, slot indices
+   * are reused so stale values are never visible to a new owner.
+   */
+  unsigned int generation;
+  tls_cleanup_thunk thunk;
+  tls_generic_function cleanup;
+};
+
+struct tls_table {
+  tls_slot *slots;
+  size_t num_slots;
+};
+
+inline tls_table& current_tls_table() {
+  static __thread tls_table table = {NULL, 0};
+  return table;
+}
+
+inline void tls_clear_slot(tls_slot *slot) {
+  void *value = slot->value;
+  tls_cleanup_thunk thunk = slot->thunk;
+  tls_generic_function cleanup = slot->cleanup;
+  slot->value = NULL;
+  slot->generation = 0;
+  if (value != NULL && thunk != NULL) {
+    thunk(value, cleanup);
+  }
+}
+
+inline void tls_table_destroy(void * /*slots*/) {
+  tls_table& table = current_tls_table();
+  /* Cleanup functions might set other values, so loop until none left. */
+  bool has_values = true;
+  while (has_values) {
+    has_values = false;
+    for (size_t i = 0; i < table.num_slots; ++i) {
+      if (table.slots[i].value != NULL) {
+        tls_clear_slot(&table.slots[i]);
+        has_values = true;
+      }
+    }
+  }
+  free(table.slots);
+  table.slots = NULL;
+  table.num_slots = 0;
+}
+
+inline pthread_key_t tls_table_key() {
+  static pthread_key_t key;
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  struct create_key {
+    static void create() {
+      pthread_key_create(&key, tls_table_destroy);
+    }
+  };
+  pthread_once(&once, create_key::create);
+  return key;
+}
+
+/* Slow path of setting a value, makes sure the table is big enough. */
+inline tls_slot *tls_ensure_slot(size_t index) {
+  tls_table& table = current_tls_table();
+  if (index >= table.num_slots) {
+    size_t num_slots = table.num_slots * 2;
+    if (num_slots <= index) {
+      num_slots = index + 16;
+    }
+    bool first_allocation = (table.slots == NULL);
+    tls_slot *slots = reinterpret_cast<tls_slot*>(
+        realloc(table.slots, num_slots * sizeof(tls_slot)));
+    assert(slots != NULL);
+    memset(slots + table.num_slots,
+           0,
+           (num_slots - table.num_slots) * sizeof(tls_slot));
+    table.slots = slots;
+    table.num_slots = num_slots;
+    if (first_allocation) {
+      /* Key value must be non-NULL for the destructor to be called. */
+      pthread_setspecific(tls_table_key(), slots);
+    }
+  }
+  return &table.slots[index];
+}
+
+inline pthread_mutex_t *tls_registry_mutex() {
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  return &mutex;
+}
+
+inline std::vector<size_t> *&tls_free_indices() {
+  static std::vector<size_t> *free_indices = NULL;
+  return free_indices;
+}
+
+inline void tls_allocate_index(size_t *index, unsigned int *generation) {
+  static size_t num_indices = 0;
+  static unsigned int last_generation = 0;
+  pthread_mutex_lock(tls_registry_mutex());
+  std::vector<size_t> *&free_indices = tls_free_indices();
+  if (free_indices != NULL && !free_indices->empty()) {
+    *index = free_indices->back();
+    free_indices->pop_back();
+  } else {
+    *index = num_indices++;
+  }
+  if (++last_generation == 0) {
+    ++last_generation;
+  }
+  *generation = last_generation;
+  pthread_mutex_unlock(tls_registry_mutex());
+}
+
+inline void tls_free_index(size_t index) {
+  pthread_mutex_lock(tls_registry_mutex());
+  std::vector<size_t> *&free_indices = tls_free_indices();
+  if (free_indices == NULL) {
+    free_indices = new std::vector<size_t>();
+  }
+  free_indices->push_back(index);
+  pthread_mutex_unlock(tls_registry_mutex());
+}
+
+template<typename T>
+void tls_cleanup_thunk_impl(void *value, tls_generic_function cleanup) {
+  typedef void (*cleanup_function)(T*);
+  reinterpret_cast<cleanup_function>(cleanup)(static_cast<T*>(value));
+}
+
+template<typename T>
+void tls_default_delete(T *value) {
+  delete value;
+}
+
+}  /* namespace internal */
+
+/* Pointer which has a separate value in every thread.
+ *
+ * Reading is a lookup in a compiler TLS table, without pthread_getspecific.
+ * Values left in a thread are passed to the cleanup function (delete by
+ * default) when the thread exits. NULL cleanup function means values are
+ * not owned by the pointer.
+ *
+ * Destroying thread_specific_ptr cleans up the value of the calling thread
+ * only, values of other threads are cleaned up when those threads exit.
+ */
+template<typename T>
+class thread_specific_ptr {
+ public:
+  typedef void (*cleanup_function)(T*);
+
+  thread_specific_ptr()
+      : cleanup_(internal::tls_default_delete<T>) {
+    internal::tls_allocate_index(&index_, &generation_);
+  }
+
+  explicit thread_specific_ptr(cleanup_function cleanup)
+      : cleanup_(cleanup) {
+    internal::tls_allocate_index(&index_, &generation_);
+  }
+
+  ~thread_specific_ptr() {
+    reset();
+    internal::tls_free_index(index_);
+  }
+
+  T *get() const {
+    internal::tls_table& table = internal::current_tls_table();
+    if (index_ < table.num_slots &&
+        table.slots[index_].generation == generation_) {
+      return static_cast<T*>(table.slots[index_].value);
+    }
+    return NULL;
+  }
+
+  T *operator->() const {
+    return get();
+  }
+
+  T& operator*() const {
+    return *get();
+  }
+
+  /* Give up ownership of the value without calling cleanup. */
+  T *release() {
+    T *value = get();
+    if (value != NULL) {
+      internal::tls_table& table = internal::current_tls_table();
+      table.slots[index_].value = NULL;
+      table.slots[index_].generation = 0;
+    }
+    return value;
+  }
+
+  /* Replace value of the calling thread, old value is cleaned up. */
+  void reset(T *new_value = NULL) {
+    T *old_value = get();
+    if (old_value == new_value) {
+      return;
+    }
+    if (new_value == NULL && old_value == NULL) {
+      return;
+    }
+    internal::tls_slot *slot = internal::tls_ensure_slot(index_);
+    /* Value of a previous owner of this slot index. */
+    internal::tls_clear_slot(slot);
+    /* Cleanup could have grown the table. */
+    slot = internal::tls_ensure_slot(index_);
+    if (new_value != NULL) {
+      slot->value = new_value;
+      slot->generation = generation_;
+      if (cleanup_ != NULL) {
+        slot->thunk = internal::tls_cleanup_thunk_impl<T>;
+        slot->cleanup =
+            reinterpret_cast<internal::tls_generic_function>(cleanup_);
+      } else {
+        slot->thunk = NULL;
+        slot->cleanup = NULL;
+      }
+    }
+  }
+
+ protected:
+  size_t index_;
+  unsigned int generation_;
+  cleanup_function cleanup_;
+
+ private:
+  thread_specific_ptr(const thread_specific_ptr& other);
+  void operator=(const thread_specific_ptr& other);
+};
+
+/* Value which is lazily copied from the initial value in every thread
+ * which accesses it, for per-thread counters, caches and scratch buffers.
+ */
+template<typename T>
+class thread_local_value {
+ public:
+  thread_local_value() : initial_value_() {}
+
+  explicit thread_local_value(const T& initial_value)
+      : initial_value_(initial_value) {}
+
+  T& get() {
+    T *value = pointer_.get();
+    if (value == NULL) {
+      value = new T(initial_value_);
+      pointer_.reset(value);
+    }
+    return *value;
+  }
+
+  T& operator*() {
+    return get();
+  }
+
+  T *operator->() {
+    return &get();
+  }
+
+  void set(const T& value) {
+    get() = value;
+  }
+
+ protected:
+  T initial_value_;
+  thread_specific_ptr<T> pointer_;
+
+ private:
+  thread_local_value(const thread_local_value& other);
+  void operator=(const thread_local_value& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_THREAD_SPECIFIC_H_ */
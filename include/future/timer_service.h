@@ -0,0 +1,421 @@
+// Copyright (c) 2016 libfuture-c++ authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: sergey.vfx@gmail.com (Sergey Sharybin)
+
+#ifndef FUTURE_TIMER_SERVICE_H_
+#define FUTURE_TIMER_SERVICE_H_
+
+#include <stdint.h>
+#include <cassert>
+#include <vector>
+
+#include "future/bind.h"
+#include "future/cancellation.h"
+#include "future/clock.h"
+#include "future/condition_variable.h"
+#include "future/executor.h"
+#include "future/function.h"
+#include "future/mutex.h"
+#include "future/thread.h"
+
+namespace future {
+
+namespace internal {
+
+struct timer_node {
+  timer_node *prev;
+  timer_node *next;
+  uint64_t expiry_tick;
+  /* Zero for one-shot timers. */
+  uint64_t period_ticks;
+  int level;
+  int slot;
+  uint32_t index;
+  /* Bumped every time the node is released, invalidates old timer ids. */
+  uint32_t generation;
+  function::function<void(void)> function;
+  /* Cancelled timers are dropped when they expire. */
+  cancellation_token token;
+};
+
+/* Hierarchical timing wheel, Varghese & Lauck scheme 7.
+ *
+ * Every level has 256 slots and every slot of a level covers as many ticks
+ * as the whole previous level. Timers far in the future are put to the
+ * upper levels and cascaded to the lower ones as the time comes closer,
+ * insertion and removal are O(1).
+ */
+class timer_wheel {
+ public:
+  enum {
+    num_levels = 4,
+    level_bits = 8,
+    num_slots = 1 << level_bits,
+    slot_mask = num_slots - 1
+  };
+
+  explicit timer_wheel(uint64_t current_tick)
+      : current_tick_(current_tick),
+        num_timers_(0) {
+    for (int level = 0; level < num_levels; ++level) {
+      for (int slot = 0; slot < num_slots; ++slot) {
+        slots_[level][slot] = NULL;
+      }
+    }
+  }
+
+  /* Last tick which has been processed by advance(). */
+  uint64_t current_tick() const {
+    return current_tick_;
+  }
+
+  size_t num_timers() const {
+    return num_timers_;
+  }
+
+  void insert(timer_node *node) {
+    if (node->expiry_tick <= current_tick_) {
+      node->expiry_tick = current_tick_ + 1;
+    }
+    place(node);
+    ++num_timers_;
+  }
+
+  void remove(timer_node *node) {
+    if (node->prev != NULL) {
+      node->prev->next = node->next;
+    } else {
+      slots_[node->level][node->slot] = node->next;
+    }
+    if (node->next != NULL) {
+      node->next->prev = node->prev;
+    }
+    node->prev = node->next = NULL;
+    --num_timers_;
+  }
+
+  /* Process the next tick, expired timers are removed from the wheel and
+   * appended to the given vector.
+   */
+  void advance(std::vector<timer_node*> *expired) {
+    uint64_t tick = ++current_tick_;
+    for (int level = 1; level < num_levels; ++level) {
+      uint64_t level_mask = (1ULL << (level * level_bits)) - 1;
+      if ((tick & level_mask) != 0) {
+        break;
+      }
+      int slot = (int)((tick >> (level * level_bits)) & slot_mask);
+      timer_node *node = slots_[level][slot];
+      slots_[level][slot] = NULL;
+      while (node != NULL) {
+        timer_node *next = node->next;
+        place(node);
+        node = next;
+      }
+    }
+    int slot = (int)(tick & slot_mask);
+    timer_node *node = slots_[0][slot];
+    slots_[0][slot] = NULL;
+    while (node != NULL) {
+      timer_node *next = node->next;
+      node->prev = node->next = NULL;
+      --num_timers_;
+      expired->push_back(node);
+      node = next;
+    }
+  }
+
+  /* Tick at which advance() is to be called next: either the first tick
+   * with expiring timers or the next cascade of upper levels.
+   */
+  uint64_t next_tick() const {
+    uint64_t cascade_tick = (current_tick_ | slot_mask) + 1;
+    for (uint64_t tick = current_tick_ + 1; tick < cascade_tick; ++tick) {
+      if (slots_[0][tick & slot_mask] != NULL) {
+        return tick;
+      }
+    }
+    return cascade_tick;
+  }
+
+  /* Skip time when there are no timers. */
+  void set_current_tick(uint64_t tick) {
+    assert(num_timers_ == 0);
+    current_tick_ = tick;
+  }
+
+ protected:
+  /* Put node to the slot according to its distance from the current tick.
+   * Node which is further than the top level covers waits in its furthest
+   * slot and is placed again once cascaded from there, keeping its expiry.
+   */
+  void place(timer_node *node) {
+    const uint64_t max_delta = (1ULL << (num_levels * level_bits)) - 1;
+    uint64_t delta = node->expiry_tick - current_tick_;
+    uint64_t slot_tick = node->expiry_tick;
+    if (delta > max_delta) {
+      delta = max_delta;
+      slot_tick = current_tick_ + max_delta;
+    }
+    int level = 0;
+    while (delta >= (1ULL << ((level + 1) * level_bits))) {
+      ++level;
+    }
+    int slot = (int)((slot_tick >> (level * level_bits)) & slot_mask);
+    node->level = level;
+    node->slot = slot;
+    node->prev = NULL;
+    node->next = slots_[level][slot];
+    if (node->next != NULL) {
+      node->next->prev = node;
+    }
+    slots_[level][slot] = node;
+  }
+
+  timer_node *slots_[num_levels][num_slots];
+  uint64_t current_tick_;
+  size_t num_timers_;
+};
+
+}  /* namespace internal */
+
+/* Runs functions after a delay or periodically.
+ *
+ * Timers are kept in a hierarchical timing wheel served by a dedicated
+ * thread, expired functions are submitted to the given executor, or run
+ * on the timer thread itself if there's no executor.
+ */
+class timer_service {
+ public:
+  typedef function::function<void(void)> function_type;
+  /* Zero is never a valid timer id. */
+  typedef uint64_t timer_id;
+
+  explicit timer_service(executor *target = NULL,
+                         uint64_t resolution_ms = 1)
+      : target_(target),
+        resolution_ns_(resolution_ms * 1000000ULL),
+        start_ns_(internal::monotonic_time_ns()),
+        mutex_("timer_service"),
+        wheel_(0),
+        wake_tick_(~(uint64_t)0),
+        stopping_(false) {
+    assert(resolution_ms > 0);
+    thread_ = new thread(::future::bind::function_bind(&timer_service::run,
+                                                       this));
+  }
+
+  /* Timers which did not expire yet are dropped. */
+  ~timer_service() {
+    {
+      mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      wake_.notify_one();
+    }
+    thread_->join();
+    delete thread_;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      delete nodes_[i];
+    }
+  }
+
+  /* Runs function once after the given delay. */
+  timer_id schedule_after(
+      uint64_t delay_ms,
+      function_type function,
+      const cancellation_token& token = cancellation_token()) {
+    return schedule(delay_ms, 0, function, token);
+  }
+
+  /* Runs function every period, the first time after one period. Periodic
+   * timer stops once its token is cancelled.
+   */
+  timer_id schedule_every(
+      uint64_t period_ms,
+      function_type function,
+      const cancellation_token& token = cancellation_token()) {
+    assert(period_ms > 0);
+    return schedule(period_ms, period_ms, function, token);
+  }
+
+  /* Returns false if the timer already fired or was cancelled. Invocations
+   * which are already submitted to the executor are not affected.
+   */
+  bool cancel(timer_id id) {
+    mutex::scoped_lock lock(mutex_);
+    uint32_t index = (uint32_t)(id & 0xffffffff);
+    uint32_t generation = (uint32_t)(id >> 32);
+    if (index == 0 || index > nodes_.size()) {
+      return false;
+    }
+    internal::timer_node *node = nodes_[index - 1];
+    if (node->generation != generation) {
+      return false;
+    }
+    wheel_.remove(node);
+    release_node(node);
+    return true;
+  }
+
+  size_t num_timers() {
+    mutex::scoped_lock lock(mutex_);
+    return wheel_.num_timers();
+  }
+
+ protected:
+  uint64_t now_tick() const {
+    return (internal::monotonic_time_ns() - start_ns_) / resolution_ns_;
+  }
+
+  timer_id schedule(uint64_t delay_ms,
+                    uint64_t period_ms,
+                    function_type function,
+                    const cancellation_token& token) {
+    uint64_t period_ticks =
+        (period_ms * 1000000ULL + resolution_ns_ - 1) / resolution_ns_;
+    mutex::scoped_lock lock(mutex_);
+    internal::timer_node *node = allocate_node();
+    /* Round up, so timer never fires before the delay passed. */
+    uint64_t expiry_ns = internal::monotonic_time_ns() - start_ns_ +
+                         delay_ms * 1000000ULL;
+    node->expiry_tick = (expiry_ns + resolution_ns_ - 1) / resolution_ns_;
+    node->period_ticks = period_ticks;
+    node->function = function;
+    node->token = token;
+    if (wheel_.num_timers() == 0) {
+      wheel_.set_current_tick(now_tick());
+    }
+    wheel_.insert(node);
+    /* Timer thread only needs a kick if it's going to sleep past this
+     * timer.
+     */
+    if (node->expiry_tick < wake_tick_) {
+      wake_tick_ = node->expiry_tick;
+      wake_.notify_one();
+    }
+    return ((uint64_t)node->generation << 32) | (node->index + 1);
+  }
+
+  internal::timer_node *allocate_node() {
+    internal::timer_node *node;
+    if (!free_nodes_.empty()) {
+      node = nodes_[free_nodes_.back()];
+      free_nodes_.pop_back();
+    } else {
+      node = new internal::timer_node();
+      node->index = (uint32_t)nodes_.size();
+      node->generation = 1;
+      nodes_.push_back(node);
+    }
+    node->prev = node->next = NULL;
+    return node;
+  }
+
+  void release_node(internal::timer_node *node) {
+    if (++node->generation == 0) {
+      node->generation = 1;
+    }
+    node->function = function_type();
+    node->token = cancellation_token();
+    free_nodes_.push_back(node->index);
+  }
+
+  void run() {
+    std::vector<internal::timer_node*> expired;
+    std::vector<function_type*> functions;
+    std::vector<cancellation_token> tokens;
+    mutex::scoped_lock lock(mutex_);
+    while (!stopping_) {
+      uint64_t tick = now_tick();
+      if (wheel_.num_timers() == 0) {
+        wake_tick_ = ~(uint64_t)0;
+        wake_.wait(lock);
+        continue;
+      }
+      while (wheel_.current_tick() < tick) {
+        wheel_.advance(&expired);
+      }
+      if (expired.empty()) {
+        uint64_t next_tick = wheel_.next_tick();
+        wake_tick_ = next_tick;
+        uint64_t wake_ns = start_ns_ + next_tick * resolution_ns_;
+        uint64_t now_ns = internal::monotonic_time_ns();
+        if (wake_ns > now_ns) {
+          wake_.wait_for(lock, (wake_ns - now_ns + 999999) / 1000000);
+        }
+        continue;
+      }
+      for (size_t i = 0; i < expired.size(); ++i) {
+        internal::timer_node *node = expired[i];
+        if (node->token.is_cancelled()) {
+          release_node(node);
+          continue;
+        }
+        functions.push_back(new function_type(node->function));
+        tokens.push_back(node->token);
+        if (node->period_ticks != 0) {
+          node->expiry_tick += node->period_ticks;
+          wheel_.insert(node);
+        } else {
+          release_node(node);
+        }
+      }
+      expired.clear();
+      lock.unlock();
+      /* Token is checked again, it might have been cancelled since the timer
+       * expired.
+       */
+      for (size_t i = 0; i < functions.size(); ++i) {
+        if (target_ != NULL) {
+          target_->submit(*functions[i], tokens[i]);
+        } else if (!tokens[i].is_cancelled()) {
+          (*functions[i])();
+        }
+        delete functions[i];
+      }
+      functions.clear();
+      tokens.clear();
+      lock.lock();
+    }
+  }
+
+  executor *target_;
+  uint64_t resolution_ns_;
+  uint64_t start_ns_;
+
+  mutex mutex_;
+  condition_variable wake_;
+  internal::timer_wheel wheel_;
+  std::vector<internal::timer_node*> nodes_;
+  std::vector<uint32_t> free_nodes_;
+  /* Tick until which the timer thread is going to sleep. */
+  uint64_t wake_tick_;
+  bool stopping_;
+  thread *thread_;
+
+ private:
+  timer_service(const timer_service& other);
+  void operator=(const timer_service& other);
+};
+
+}  /* namespace future */
+
+#endif  /* FUTURE_TIMER_SERVICE_H_ */